@@ -32,6 +32,8 @@
 #include "string.h"
 #include "bdosstub.h"
 #include "tosvars.h"
+#include "cookie.h"
+#include "biosext.h"
 
 /*
 **  externals
@@ -41,7 +43,6 @@
  * in rwa.S
  */
 
-void enter(void);       /* defined in rwa.S */
 void bdos_trap2(void);  /* defined in rwa.S */
 PFVOID old_trap2; /* Old trap #2 handler, also used by rwa.S */
 
@@ -211,9 +212,24 @@ static const FND funcs[] =
     { F(xsetdta),  0, 2 },      /* 0x1A */
 
     { NI, 0, 0 },
-    { NI, 0, 0 },
-    { NI, 0, 0 },
-    { NI, 0, 0 },
+
+#if CONF_WITH_FCOPY
+    { F(xfcopy),   0, 4 },      /* 0x1C - EmuTOS extension */
+#else
+    { NI, 0, 0 },               /* 0x1C */
+#endif
+
+#if CONF_WITH_FSNEXTN
+    { F(xsnextn),  0, 3 },      /* 0x1D - EmuTOS extension */
+#else
+    { NI, 0, 0 },               /* 0x1D */
+#endif
+
+#if CONF_WITH_PGMCACHE
+    { F(xpgmflush), 0, 0 },     /* 0x1E - EmuTOS extension */
+#else
+    { NI, 0, 0 },               /* 0x1E */
+#endif
     { NI, 0, 0 },
 
     /* xgsps */
@@ -291,6 +307,72 @@ static const FND funcs[] =
 #define MAX_FNCALL (ARRAY_SIZE(funcs) - 1)
 
 
+#if CONF_WITH_BDOS_STATS
+/*
+ *  GEMDOS statistics
+ */
+static void bdos_stats_dump(void);
+static void bdos_stats_reset(void);
+
+BDOSSTATS bdos_stats;
+
+static void bdos_stats_reset(void)
+{
+    bzero(&bdos_stats, sizeof(bdos_stats));
+    bdos_stats.version = 2;
+    bdos_stats.nfuncs = BDOS_STATS_NFUNCS;
+    bdos_stats.dump = bdos_stats_dump;
+    bdos_stats.reset = bdos_stats_reset;
+    bdos_stats.start = hz_200;
+}
+
+static void bdos_stats_dump(void)
+{
+    BDOSSTATS *s = &bdos_stats;
+    BDOSFNSTATS *f;
+    ULONG secs;
+    int fn, i;
+
+    secs = (hz_200 - s->start) / 200;
+    kprintf("BDOS statistics for the last %lu seconds\n", secs);
+    kprintf("cache: %lu hits, %lu misses, %lu flushes, %lu read ahead, %lu direct\n",
+            s->cachehits, s->cachemisses, s->cacheflushes, s->readaheads, s->directrecs);
+    kprintf("I/O: %lu reads (%lu records), %lu writes (%lu records)\n",
+            s->devreads, s->recsread, s->devwrites, s->recswritten);
+    kprintf("DNDs: %lu hits, %lu misses, %lu evictions\n",
+            s->dndhits, s->dndmisses, s->dndevictions);
+    kprintf("func    calls    ticks      max  histogram (0,1,2-3,...,64+ ticks)\n");
+
+    for (fn = 0, f = s->fn; fn < BDOS_STATS_NFUNCS; fn++, f++)
+    {
+        if (f->calls == 0)
+            continue;
+        kprintf("0x%02x %8lu %8lu %8lu ", fn, f->calls, f->ticks, f->maxticks);
+        for (i = 0; i < BDOS_STATS_NHIST; i++)
+            kprintf(" %lu", f->hist[i]);
+        kprintf("\n");
+    }
+}
+
+/*
+ *  bdos_stats_add - record a call that took 'ticks' ticks
+ */
+static void bdos_stats_add(BDOSFNSTATS *f, ULONG ticks)
+{
+    ULONG n;
+    int i;
+
+    f->ticks += ticks;
+    if (ticks > f->maxticks)
+        f->maxticks = ticks;
+
+    for (i = 0, n = ticks; (n > 0) && (i < BDOS_STATS_NHIST-1); i++)
+        n >>= 1;
+    f->hist[i]++;
+}
+#endif
+
+
 /*
  *  xgetver -
  *      return current version number
@@ -326,6 +408,12 @@ void osinit_before_xmaddalt(void)
     old_trap2 = (PFVOID) Setexc(0x22, (long)bdos_trap2);
 
     bufl_init();    /* initialize BDOS buffer list */
+#if CONF_WITH_FREE_BITMAP
+    fmap_init();    /* reserve memory for the free cluster bitmaps */
+#endif
+#if CONF_WITH_DIRINDEX
+    dirindex_init();    /* and for the directory indexes */
+#endif
 
     osmem_init();
     umem_init();
@@ -340,12 +428,21 @@ void osinit_after_xmaddalt(void)
     run->p_flags = PF_STANDARD;
     run->p_env = CONST_CAST(char *,double_nul);
 
+#if CONF_WITH_BDOS_CACHE && CONF_WITH_ALT_RAM
+    bufl_altram_init();     /* add buffers in alt-RAM, if available */
+#endif
+
     time_init();
 
     KDEBUG(("BDOS: address of basepage = %p\n", run));
 
     stdhdl_init();  /* set up system initial standard handles */
 
+#if CONF_WITH_BDOS_STATS
+    bdos_stats_reset();
+    cookie_add(COOKIE_BDST, (ULONG)&bdos_stats);
+#endif
+
     KDEBUG(("BDOS: cinit - osinit successful ...\n"));
 }
 
@@ -406,11 +503,91 @@ static void offree(DMD *d)
  *  osif - C implementation of trap #1. Called by _enter.
  */
 long osif(short *pw);   /* called only from rwa.S */
+
+#if CONF_WITH_BDOS_STATS || BLKDEV_HOLDS_WRITES
+static long dosif(short *pw);
+
+#if BLKDEV_HOLDS_WRITES
+/*
+ *  rc_is_status - TRUE if a function only returns a status or a byte
+ *  count, so that a failure to write the data held back by the BIOS can
+ *  be reported instead.  the other results (handles, addresses, ...)
+ *  must reach the caller.
+ */
+static BOOL rc_is_status(UWORD fn)
+{
+    switch(fn)
+    {
+    case 0x1c:      /* Fcopy */
+    case 0x39:      /* Dcreate */
+    case 0x3a:      /* Ddelete */
+    case 0x3e:      /* Fclose */
+    case 0x40:      /* Fwrite */
+    case 0x41:      /* Fdelete */
+    case 0x56:      /* Frename */
+    case 0x57:      /* Fdatime */
+        return TRUE;
+    }
+
+    return FALSE;
+}
+#endif
+
+/*
+ *  osif - with statistics, this times the calls to dosif().  calls
+ *  that don't return (e.g. Pterm()) are counted but not timed.  if the
+ *  BIOS holds back disk writes, they are written at the end of each
+ *  call; a failure is returned by the calls which return a status.
+ *  Pexec() and Pterm() leave through gouser()/termuser() instead, so
+ *  they write them themselves (see proc.c).
+ */
+long osif(short *pw)
+{
+    UWORD fn = pw[0];
+#if CONF_WITH_BDOS_STATS
+    BDOSFNSTATS *f = NULL;
+    ULONG start;
+#endif
+#if BLKDEV_HOLDS_WRITES
+    long err;
+#endif
+    long rc;
+
+#if BLKDEV_HOLDS_WRITES
+    blkdev_hold();
+#endif
+
+#if CONF_WITH_BDOS_STATS
+    if (fn < BDOS_STATS_NFUNCS)
+    {
+        f = &bdos_stats.fn[fn];
+        f->calls++;
+    }
+
+    start = hz_200;
+    rc = dosif(pw);
+    if (f)
+        bdos_stats_add(f, hz_200 - start);
+#else
+    rc = dosif(pw);
+#endif
+
+#if BLKDEV_HOLDS_WRITES
+    err = blkdev_release();
+    if ((err < 0) && (rc >= 0) && rc_is_status(fn))
+        rc = err;
+#endif
+
+    return rc;
+}
+
+static long dosif(short *pw)
+#else
 long osif(short *pw)
+#endif
 {
     char **pb, *pb2, *p, ctmp;
     BPB *b;
-    BCB *bx;
     DND *dn;
     int typ, h, i, fn;
     int num, max;
@@ -429,6 +606,9 @@ restrt:
         rc = errcode;
         /* hard error processing */
         KDEBUG(("Error code gotten from some longjmp(), back in osif(): %ld\n",rc));
+#if CONF_WITH_FCOPY
+        fcopy_cleanup();
+#endif
 
         /* is this a media change ? */
         if (rc == E_CHNG)
@@ -436,16 +616,16 @@ restrt:
             /* first, out with the old stuff */
             dn = drvtbl[errdrv]->m_dtl;
             offree(drvtbl[errdrv]);
+#if CONF_WITH_FREE_BITMAP
+            fmap_free(drvtbl[errdrv]);
+#endif
             xmfreblk(drvtbl[errdrv]);
             drvtbl[errdrv] = 0;
 
             if (dn)
                 freetree(dn);
 
-            for (i = 0; i < 2; i++)
-                for (bx = bufl[i]; bx; bx = bx->b_link)
-                    if (bx->b_bufdrv == errdrv)
-                        bx->b_bufdrv = -1;
+            bufl_invalidate(errdrv);
 
             /* then, in with the new */
             b = (BPB *)Getbpb(errdrv);
@@ -465,10 +645,7 @@ restrt:
 
         /* else handle as hard error on disk for now */
 
-        for (i = 0; i < 2; i++)
-            for (bx = bufl[i]; bx; bx = bx->b_link)
-                if (bx->b_bufdrv == errdrv)
-                    bx->b_bufdrv = -1;
+        bufl_invalidate(errdrv);
         return rc;
     }
 
@@ -605,15 +782,16 @@ restrt:
 
                 pb2 = *pb;      /* char * is buffer address */
 
-                for (n = 0; n < count; n++)
+                if (num == H_Console)
                 {
-                    if (num == H_Console)
-                        tabout(HXFORM(num), (unsigned char)*pb2++);
-                    else
-                    {           /* M01.01.1029.01 */
-                        if (Bconout(HXFORM(num), (unsigned char)*pb2++) == 0)
-                            return n;
-                    }
+                    conwrite(HXFORM(num), pb2, count);
+                    return count;
+                }
+
+                for (n = 0; n < count; n++)
+                {               /* M01.01.1029.01 */
+                    if (Bconout(HXFORM(num), (unsigned char)*pb2++) == 0)
+                        return n;
                 }
 
                 return count;
@@ -25,6 +25,10 @@ long xmaddalt(UBYTE *start, long size);
 long total_alt_ram(void);
 #endif /* CONF_WITH_ALT_RAM */
 
+/* Allocate memory from the GEMDOS pools, for BIOS buffers.
+ * Only valid after BDOS initialization. */
+void *xmxalloc(long amount, int mode);
+
 /* BDOS quick pool.
  * Declared here because referenced by the BIOS OSHEADER */
 #define MAXQUICK 5
@@ -22,7 +22,9 @@
 #include "proc.h"
 #include "console.h"
 #include "biosbind.h"
+#include "biosext.h"
 #include "bdosstub.h"
+#include "string.h"
 
 /*
  * The following structure is used for the typeahead buffer
@@ -100,6 +102,10 @@ static int backsp(int h, char *cbuf, int retlen, int col);
 
 #define terminate() xterm(-32)
 
+#if CONF_WITH_BATCHED_CONOUT
+#define CONOUT_RUN  128     /* max chars output between control-s checks */
+#endif
+
 
 /*
  * set up system initial standard handles
@@ -303,6 +309,53 @@ void tabout(int h, int ch)
 }
 
 
+/*
+ * conwrite - console output of a buffer with tab expansion
+ *
+ * @h - device handle
+ * @p - pointer to characters
+ * @count - number of characters
+ *
+ * This is the same as calling tabout() for each character.  However,
+ * runs of printable characters are passed to the BIOS console in one
+ * go, with a single check for control-s/control-c per run, unless
+ * console output has been redirected.
+ */
+void conwrite(int h, const char *p, long count)
+{
+#if CONF_WITH_BATCHED_CONOUT
+    BOOL batch = (h == HXFORM(H_Console));
+    WORD n;
+
+    while (count > 0)
+    {
+        if (batch)
+        {
+            for (n = 0; (n < count) && (n < CONOUT_RUN) && ((unsigned char)p[n] >= ' '); n++)
+                ;
+            if (n > 1)
+            {
+                conbrk(h);          /* check for control-s break */
+                if (con_outs((const UBYTE *)p, n))
+                {
+                    glbcolumn[h] += n;
+                    p += n;
+                    count -= n;
+                    continue;
+                }
+                batch = FALSE;      /* redirected, don't try again */
+            }
+        }
+        tabout(h, (unsigned char)*p++);
+        count--;
+    }
+#else
+    while (count-- > 0)
+        tabout(h, (unsigned char)*p++);
+#endif
+}
+
+
 /*
  * cookdout - console output with tab and control character expansion
  *
@@ -467,8 +520,7 @@ void xconws(char *p)
  */
 static void prt_line(int h, char *p)
 {
-    while(*p)
-        tabout(h, (unsigned char)*p++);
+    conwrite(h, p, strlen(p));
 }
 
 
@@ -57,10 +57,28 @@ extern  jmp_buf errbuf;
 extern  int     errdrv;
 extern  long    errcode;
 
+/*
+ *  Statistics (see BDOSSTATS)
+ */
+
+#if CONF_WITH_BDOS_STATS
+extern  BDOSSTATS bdos_stats;
+#define BDOS_COUNT(field,n)     (bdos_stats.field += (n))
+#define BDOS_COUNT_RWABS(flg,cnt)                     \
+    if ((flg) & 1)                                    \
+        bdos_stats.devwrites++, bdos_stats.recswritten += (cnt); \
+    else                                              \
+        bdos_stats.devreads++, bdos_stats.recsread += (cnt);
+#else
+#define BDOS_COUNT(field,n)     NULL_FUNCTION()
+#define BDOS_COUNT_RWABS(flg,cnt)
+#endif
+
 #define longjmp_rwabs(flg,buf,cnt,rec,dev)            \
     if (rec <= 32767)                                 \
     {                                                 \
         /* kprintf("\nRwabs short, rec = %i\n", (int)(rec)); */ \
+        BDOS_COUNT_RWABS(flg,cnt)                     \
         if ((rwerr=Rwabs(flg,buf,cnt,rec,dev,0))!=0)  \
         {                                             \
              errdrv=dev; errcode=rwerr;               \
@@ -70,6 +88,7 @@ extern  long    errcode;
     else                                              \
     {                                                 \
         /* kprintf(__FILE__ "%i: Rwabs rec=%li\n", __LINE__, (long)(rec)); */ \
+        BDOS_COUNT_RWABS(flg,cnt)                     \
         if ((rwerr=Rwabs(flg,buf,cnt,-1,dev,rec))!=0) \
         {                                             \
              errdrv=dev; errcode=rwerr;               \
@@ -121,6 +140,10 @@ typedef struct
     DOSTIME o_td;       /* creation time/date: little-endian!   */
     CLNO  o_strtcl;     /* starting cluster number              */
     long  o_fileln;     /* length of file in bytes              */
+#if CONF_WITH_PREALLOC
+    CLNO  o_rsvcl;      /* first cluster reserved for file      */
+    CLNO  o_rsvcnt;     /* number of clusters reserved          */
+#endif
 } DFD;
 
 
@@ -152,6 +175,9 @@ struct _ofd
     UWORD o_curbyt;     /* byte pointer within current cluster  */
     OFD   *o_thread;    /* multiple open thread list            */
     UWORD o_mod;        /* mode file opened in (see below)      */
+#if CONF_WITH_READAHEAD
+    UWORD o_rawin;      /* read-ahead window in records, or 0   */
+#endif
 
     DFD   o_disk;       /* data to be synchronised with the disk*/
 } ;
@@ -222,6 +248,7 @@ struct _dnd         /* directory node descriptor */
 
     long d_scan;        /*  current posn in dir for DND tree    */
     OFD  *d_files;      /* open files on this node              */
+    ULONG d_used;       /* last use, for LRU eviction           */
 } ;
 
 /*
@@ -236,6 +263,8 @@ struct _dnd         /* directory node descriptor */
  *  DMD - Drive Media Block
  *
  *  note: in the following comments, records == logical sectors
+ *
+ *  this structure must not exceed 64 bytes in length
  */
 struct _dmd         /* drive media block */
 {
@@ -259,6 +288,14 @@ struct _dmd         /* drive media block */
     DND    *m_dtl;      /* root of directory tree list          */
     UBYTE  m_16;        /* 16 bit fat ?                         */
     UBYTE  m_1fat;      /* 1 FAT only ?                         */
+#if CONF_WITH_FREE_BITMAP
+    UWORD  *m_fmap;     /* bitmap of free clusters, or NULL     */
+    CLNO   m_fmhint;    /* no free clusters below this one      */
+    CLNO   m_nfree;     /* number of free clusters (if m_fmap)  */
+#endif
+#if CONF_WITH_PREALLOC
+    CLNO   m_nresv;     /* number of clusters reserved by files */
+#endif
 } ;
 
 
@@ -407,11 +444,35 @@ BOOL contains_illegal_characters(const char *test);
  */
 
 void bufl_init(void);
+#if CONF_WITH_BDOS_CACHE && CONF_WITH_ALT_RAM
+/* add buffers in alt-RAM */
+void bufl_altram_init(void);
+#endif
+/* invalidate all buffers for a drive */
+void bufl_invalidate(int drv);
 /* ??? */
 void flush(BCB *b);
+#if CONF_WITH_FAT_WRITEBACK
+/* write all dirty FAT buffers for a drive (or all drives if negative) */
+void flush_fat(int drv);
+#endif
 /* return the ptr to the buffer containing the desired record */
 UBYTE *getrec(RECNO recn, OFD *of, int wrtflg);
 BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum);
+#if CONF_WITH_BDOS_CACHE
+/* keep the cache coherent after a direct transfer of data records */
+void bufl_direct(DMD *dm, int rwflg, RECNO strt, int num, UBYTE *ubuf);
+#endif
+#if CONF_WITH_READAHEAD
+BOOL readahead_wanted(DMD *dm, RECNO recn);
+WORD readahead(DMD *dm, RECNO recn, WORD n);
+#endif
+/* validate the media in a drive before trusting cached records */
+#if CONF_WITH_MEDIACH_POLICY
+#define chkmedia(drv)   (blkdev_mcneeded(drv) ? Mediach(drv) : 0L)
+#else
+#define chkmedia(drv)   Mediach(drv)
+#endif
 
 /*
  * in fsfat.c
@@ -421,6 +482,18 @@ RECNO cl2rec(CLNO cl, DMD *dm);
 void clfix(CLNO cl, CLNO link, DMD *dm);
 CLNO getrealcl(CLNO cl, DMD *dm);
 CLNO getclnum(CLNO cl, OFD *of);
+CLNO getclidx(OFD *of, CLNO cl, CLNO curidx, CLNO idx);
+#if CONF_WITH_EXTENT_MAP
+void extmap_invalidate(void);
+#endif
+#if CONF_WITH_FREE_BITMAP
+void fmap_init(void);
+void fmap_free(DMD *dm);
+#endif
+#if CONF_WITH_PREALLOC
+void prealloc(OFD *p, LONG size);
+void prealloc_release(OFD *p);
+#endif
 int nextcl(OFD *p, int wrtflg);
 long xgetfree(long *buf, int drv);
 
@@ -442,6 +515,17 @@ long ixread(OFD *p, long len, void *ubufr);
 
 long xwrite(int h, long len, void *ubufr);
 long ixwrite(OFD *p, long len, void *ubufr);
+#if CONF_WITH_FCOPY
+long xfcopy(int hsrc, int hdst, long len);
+void fcopy_cleanup(void);
+#endif
+
+/*
+ * in rwa.S
+ */
+
+/* trap #1 handler, used to check whether GEMDOS has been hooked */
+void enter(void);
 
 /*
  * in fsdir.c
@@ -453,6 +537,9 @@ long xchmod(char *p, int wrt, UBYTE mod);
 long ixsfirst(char *name, WORD att, DTAINFO *addr);
 long xsfirst(char *name, int att);
 long xsnext(void);
+#if CONF_WITH_FSNEXTN
+long xsnextn(DTAENTRY *buf, int count);
+#endif
 long xgsdtof(DOSTIME *buf, int h, int wrt);
 void builds(const char *s1 , char *s2 );
 long xrename(int n, char *p1, char *p2);
@@ -464,7 +551,21 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp);
 int incr_curdir_usage(DND *dnd);
 void decr_curdir_usage(int index);
 OFD *makofd(DND *p);
-WORD free_available_dnds(void);
+WORD free_available_dnds(BOOL for_md);
+#if CONF_WITH_DIRINDEX
+void dirindex_init(void);
+void dirindex_add(DND *dn, LONG pos, const char *name);
+void dirindex_free(DND *dn, LONG pos);
+void dirindex_drop(DMD *dm, CLNO cl);
+#endif
+
+/*
+ * in kpgmld.c
+ */
+#if CONF_WITH_PGMCACHE
+/* drop cached programs from the file starting at cl on dm */
+void pgmcache_drop(DMD *dm, CLNO cl);
+#endif
 
 
 /*
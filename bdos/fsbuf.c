@@ -2,7 +2,7 @@
  * fsbuf.c - buffer mgmt for file system
  *
  * Copyright (C) 2001 Lineo, Inc.
- *               2002-2022 The EmuTOS development team
+ *               2002-2024 The EmuTOS development team
  *
  * Authors:
  *  SCC   Steve C. Cavender
@@ -22,9 +22,458 @@
 #include "string.h"
 #include "tosvars.h"
 #include "biosext.h"
+#include "bdosstub.h"
+#include "has.h"
 
 #define NUMBUFS 2       /* buffers per list */
 
+#if CONF_WITH_FAT_WRITEBACK || CONF_WITH_READAHEAD
+/*
+ * the run buffer is used to transfer runs of consecutive records with a
+ * single Rwabs(), both for FAT write-back and for read-ahead.  it is only
+ * allocated if it can hold several records.
+ */
+#if CONF_WITH_READAHEAD && (CONF_READAHEAD_SIZE > CONF_FAT_WRITEBACK_RUNSIZE || !CONF_WITH_FAT_WRITEBACK)
+#define RUNBUF_SIZE CONF_READAHEAD_SIZE
+#else
+#define RUNBUF_SIZE CONF_FAT_WRITEBACK_RUNSIZE
+#endif
+
+static UBYTE *runbuf;
+#endif
+
+#if CONF_WITH_FAT_WRITEBACK
+/*
+ * FAT write-back
+ *
+ * dirty FAT buffers are not written individually; instead, flush_fat()
+ * writes all of them for a drive in ascending record order, merging
+ * consecutive records into single writes via runbuf.  fatdeadline
+ * is the hz_200 time by which dirty FAT buffers must have been written
+ * (0 if none are pending).
+ */
+static LONG fatdeadline;
+#endif
+
+#if CONF_WITH_FAT_WRITEBACK || CONF_WITH_READAHEAD
+static void runbuf_init(void)
+{
+    runbuf = NULL;
+#if CONF_WITH_FAT_WRITEBACK
+    fatdeadline = 0;
+#endif
+
+    /* merging is only worthwhile if the buffer holds several records */
+    if (pun_ptr->max_sect_siz < RUNBUF_SIZE/2)
+        runbuf = balloc_stram(RUNBUF_SIZE, FALSE);
+}
+#endif
+
+#if CONF_WITH_BDOS_CACHE
+
+/*
+ * BCBX - extended BCB
+ *
+ * Each buffer that we allocate ourselves is controlled by one of these.
+ * The embedded BCB is what is linked into the bufl[] chains, so that
+ * programs which inspect or extend the chains still see standard BCBs.
+ * The extension holds the links for the hash index and the LRU list.
+ */
+typedef struct _bcbx BCBX;
+struct _bcbx
+{
+    BCB     bx_bcb;     /* must be first */
+    BCBX    *bx_hlink;  /* next BCBX on same hash chain */
+    BCBX    *bx_newer;  /* LRU list: next more recently used BCBX */
+    BCBX    *bx_older;  /* LRU list: next less recently used BCBX */
+    WORD    bx_hash;    /* index of hash chain, or -1 if not hashed */
+};
+
+/* keep the sector buffers on a long boundary */
+#define BCBX_LEN        ((sizeof(BCBX)+3) & ~3)
+
+/*
+ * there is one LRU list per buffer list.  we also remember the first
+ * and last of our own BCBs in each bufl[] chain, so that we can detect
+ * BCBs that have been added by other programs.
+ */
+typedef struct
+{
+    BCBX    *newest;    /* most recently used */
+    BCBX    *oldest;    /* least recently used */
+    BCB     *first;     /* first of our BCBs in bufl[] chain */
+    BCB     *last;      /* last of our BCBs in bufl[] chain */
+} LRULIST;
+
+static LRULIST lru[2];
+
+/*
+ * the hash index: an array of chains of BCBXs, keyed on drive,
+ * buffer type and record number.  the number of chains is a power
+ * of 2, and at least the total number of our buffers.
+ */
+static BCBX **bcbhash;
+static UWORD hashmask;
+static UWORD numbcbx;       /* total number of BCBXs */
+
+#define HASH(drv,typ,rec)   (((UWORD)(rec) ^ (UWORD)((rec)>>16) ^ ((drv)<<7) ^ ((typ)<<13)) & hashmask)
+
+/*
+ * the memory areas containing our BCBXs: one allocated at boot time
+ * in ST-RAM, and possibly one more in alt-RAM
+ */
+#define MAX_BUFPOOLS    2
+static struct {
+    UBYTE *start;
+    UBYTE *end;
+} bufpool[MAX_BUFPOOLS];
+static WORD numpools;
+
+
+/*
+ * is_own - return TRUE iff the BCB is one of ours
+ */
+static BOOL is_own(BCB *b)
+{
+    WORD i;
+
+    for (i = 0; i < numpools; i++)
+        if (((UBYTE *)b >= bufpool[i].start) && ((UBYTE *)b < bufpool[i].end))
+            return TRUE;
+
+    return FALSE;
+}
+
+
+/*
+ * LRU list handling
+ */
+static void lru_unlink(LRULIST *l, BCBX *bx)
+{
+    if (bx->bx_newer)
+        bx->bx_newer->bx_older = bx->bx_older;
+    else l->newest = bx->bx_older;
+
+    if (bx->bx_older)
+        bx->bx_older->bx_newer = bx->bx_newer;
+    else l->oldest = bx->bx_newer;
+}
+
+static void lru_make_newest(LRULIST *l, BCBX *bx)
+{
+    if (l->newest == bx)
+        return;
+
+    lru_unlink(l, bx);
+    bx->bx_newer = NULL;
+    bx->bx_older = l->newest;
+    if (l->newest)
+        l->newest->bx_newer = bx;
+    else l->oldest = bx;
+    l->newest = bx;
+}
+
+static void lru_make_oldest(LRULIST *l, BCBX *bx)
+{
+    if (l->oldest == bx)
+        return;
+
+    lru_unlink(l, bx);
+    bx->bx_older = NULL;
+    bx->bx_newer = l->oldest;
+    if (l->oldest)
+        l->oldest->bx_older = bx;
+    else l->newest = bx;
+    l->oldest = bx;
+}
+
+
+/*
+ * hash index handling
+ *
+ * note that other code may invalidate a buffer by setting b_bufdrv to -1
+ * without removing it from the index.  this is harmless, since lookups
+ * always check the contents of the BCB.
+ */
+static void hash_insert(BCBX *bx)
+{
+    BCB *b = &bx->bx_bcb;
+    UWORD h = HASH(b->b_bufdrv, b->b_buftyp, b->b_bufrec);
+
+    bx->bx_hlink = bcbhash[h];
+    bcbhash[h] = bx;
+    bx->bx_hash = h;
+}
+
+static void hash_remove(BCBX *bx)
+{
+    BCBX **q;
+
+    if (bx->bx_hash < 0)
+        return;
+
+    for (q = &bcbhash[bx->bx_hash]; *q; q = &(*q)->bx_hlink)
+    {
+        if (*q == bx)
+        {
+            *q = bx->bx_hlink;
+            break;
+        }
+    }
+    bx->bx_hash = -1;
+}
+
+static BCBX *hash_lookup(WORD drv, WORD buftype, RECNO recnum)
+{
+    BCBX *bx;
+
+    for (bx = bcbhash[HASH(drv,buftype,recnum)]; bx; bx = bx->bx_hlink)
+    {
+        if ((bx->bx_bcb.b_bufrec == recnum) && (bx->bx_bcb.b_bufdrv == drv)
+         && (bx->bx_bcb.b_buftyp == buftype))
+            return bx;
+    }
+
+    return NULL;
+}
+
+/*
+ * hash_rebuild - (re)initialise the hash index from the LRU lists
+ */
+static void hash_rebuild(void)
+{
+    BCBX *bx;
+    WORD i;
+
+    bzero(bcbhash, (hashmask+1UL)*sizeof(BCBX *));
+
+    for (i = BI_FAT; i <= BI_DATA; i++)
+    {
+        for (bx = lru[i].newest; bx; bx = bx->bx_older)
+        {
+            bx->bx_hash = -1;
+            if (bx->bx_bcb.b_bufdrv != -1)
+                hash_insert(bx);
+        }
+    }
+}
+
+
+/*
+ * hash_size - return the number of hash chains for 'n' buffers
+ */
+static UWORD hash_size(UWORD n)
+{
+    UWORD size;
+
+    for (size = 16; size < n; size <<= 1)
+        ;
+
+    return size;
+}
+
+
+/*
+ * cache_bufs - determine the number of buffers to allocate
+ *
+ * we use about 1/64 of the available memory, limited to 'maxsize' bytes,
+ * and always allocate at least NUMBUFS per list
+ */
+static UWORD cache_bufs(ULONG memsize, ULONG maxsize, LONG buflen)
+{
+    ULONG n;
+
+    memsize >>= 6;
+    if (memsize > maxsize)
+        memsize = maxsize;
+
+    n = memsize / buflen;
+    if (n < 2*NUMBUFS)
+        n = 2*NUMBUFS;
+
+    return n;
+}
+
+
+/*
+ * create_chain - create a chain of BCBXs and corresponding buffers
+ *
+ * the BCBs are linked to each other in order, and the BCBXs are added to
+ * the LRU list as the least recently used.  returns ptr to next free byte.
+ */
+static UBYTE *create_chain(UBYTE *p, LONG n, UWORD count, LRULIST *l)
+{
+    BCBX *bx;
+    BCB *b;
+    UWORD i;
+
+    for (i = 0; i < count; i++, p += n)
+    {
+        bx = (BCBX *)p;
+        bzero(bx, BCBX_LEN);
+        b = &bx->bx_bcb;
+        if (i < count-1)                    /* chain to next */
+            b->b_link = (BCB *)(p + n);
+        b->b_bufdrv = -1;                   /* mark as invalid */
+        b->b_bufr = p + BCBX_LEN;
+        bx->bx_hash = -1;
+
+        bx->bx_newer = l->oldest;           /* add at LRU end */
+        if (l->oldest)
+            l->oldest->bx_older = bx;
+        else l->newest = bx;
+        l->oldest = bx;
+    }
+    numbcbx += count;
+
+    return p;
+}
+
+
+/*
+ * add_chain - create buffers and link them into the specified bufl[] chain
+ *
+ * the new buffers are linked immediately after the last of our existing
+ * buffers (if any), so that BCBs added by other programs remain in place
+ */
+static UBYTE *add_chain(UBYTE *p, LONG n, UWORD count, WORD list)
+{
+    LRULIST *l = &lru[list];
+    BCB *first = (BCB *)p;
+
+    p = create_chain(p, n, count, l);
+
+    if (l->last)
+    {
+        ((BCB *)(p - n))->b_link = l->last->b_link;
+        l->last->b_link = first;
+    }
+    else
+    {
+        bufl[list] = l->first = first;
+    }
+    l->last = (BCB *)(p - n);
+
+    return p;
+}
+
+
+/*
+ * bufl_init - BDOS buffer list initialization
+ *
+ * this must be called before memory is initialised, because we use
+ * balloc_stram().  we use balloc_stram() because we must not use
+ * Malloc() until after we have finished booting.  this is because TOS
+ * doesn't, and some programs that are direct-booted from a disk may
+ * therefore assume that all memory from membot upwards is available
+ * (I'm looking at you, Dungeon Master).
+ *
+ * the number of buffers is derived from the amount of available ST-RAM;
+ * one quarter of them is used for the FAT list.
+ */
+void bufl_init(void)
+{
+    UBYTE *p;
+    LONG n, size;
+    UWORD count, nfat, nhash;
+
+    n = BCBX_LEN + pun_ptr->max_sect_siz;
+    count = cache_bufs(memtop - membot, CONF_BDOS_CACHE_STRAM_SIZE, n);
+    nfat = count / 4;
+    if (nfat < NUMBUFS)
+        nfat = NUMBUFS;
+    nhash = hash_size(count);
+
+    size = count * n + nhash * sizeof(BCBX *);
+    p = balloc_stram(size, FALSE);
+    if (!p)
+        panic("bufl_init(%ld): no memory\n",size);
+
+    bufpool[0].start = p;
+    bufpool[0].end = p + count * n;
+    numpools = 1;
+
+    bzero(lru, sizeof(lru));
+    numbcbx = 0;
+
+    p = add_chain(p, n, nfat, BI_FAT);          /* set up FAT chain */
+    p = add_chain(p, n, count-nfat, BI_DATA);   /* set up dir/data chain */
+
+    bcbhash = (BCBX **)p;
+    hashmask = nhash - 1;
+    hash_rebuild();
+
+    KDEBUG(("bufl_init(): %u FAT buffers, %u dir/data buffers, %u hash chains\n",
+            nfat, count-nfat, nhash));
+
+#if CONF_WITH_FAT_WRITEBACK || CONF_WITH_READAHEAD
+    runbuf_init();
+#endif
+}
+
+
+#if CONF_WITH_ALT_RAM
+/*
+ * bufl_altram_init - grow the buffer lists using alt-RAM
+ *
+ * this is called after any alt-RAM has been made known to GEMDOS.  as
+ * for bufl_init(), the number of buffers added depends on the amount of
+ * memory, and one quarter of them is used for the FAT list.  if the
+ * hash index becomes too small, it is replaced by a larger one.  the
+ * buffers themselves may be put in ST-RAM, see blkdev_mxalloc_mode().
+ */
+void bufl_altram_init(void)
+{
+    UBYTE *p;
+    LONG n, size;
+    UWORD count, nfat, nhash;
+
+    if (!has_alt_ram || (numpools >= MAX_BUFPOOLS))
+        return;
+
+    n = BCBX_LEN + pun_ptr->max_sect_siz;
+    count = cache_bufs(total_alt_ram(), CONF_BDOS_CACHE_ALTRAM_SIZE, n);
+    nfat = count / 4;
+    nhash = hash_size(numbcbx + count);
+    if (nhash <= hashmask + 1)
+        nhash = 0;              /* current hash index is big enough */
+
+    size = count * n + nhash * sizeof(BCBX *);
+    p = NULL;
+#if CONF_WITH_DMA_BOUNCE
+    /*
+     * if the hard disks can only do DMA to ST-RAM, buffers there avoid a
+     * copy per transfer: use it if that takes at most 1/8 of what is free
+     */
+    if ((blkdev_mxalloc_mode() == MX_STRAM) && (size <= (LONG)xmxalloc(-1L, MX_STRAM) / 8))
+        p = xmxalloc(size, MX_STRAM);
+    if (!p)
+#endif
+        p = xmxalloc(size, MX_TTRAM);
+    if (!p)
+        return;
+
+    bufpool[numpools].start = p;
+    bufpool[numpools].end = p + count * n;
+    numpools++;
+
+    p = add_chain(p, n, nfat, BI_FAT);
+    p = add_chain(p, n, count-nfat, BI_DATA);
+
+    if (nhash)
+    {
+        bcbhash = (BCBX **)p;
+        hashmask = nhash - 1;
+    }
+    hash_rebuild();
+
+    KDEBUG(("bufl_altram_init(): added %u FAT buffers, %u dir/data buffers\n",
+            nfat, count-nfat));
+}
+#endif
+
+#else
+
 /* creates a chain of BCBs and corresponding buffers */
 static void *create_chain(UBYTE *p,LONG n)
 {
@@ -70,7 +519,147 @@ void bufl_init(void)
     /* set up dir/data chain */
     bufl[BI_DATA] = (BCB *)p;
     create_chain(p,n);
+
+#if CONF_WITH_FAT_WRITEBACK || CONF_WITH_READAHEAD
+    runbuf_init();
+#endif
+}
+
+#endif /* CONF_WITH_BDOS_CACHE */
+
+
+
+/*
+ * bufl_invalidate - invalidate all buffers for the specified drive
+ *
+ * this is used after a media change or a hard error; any dirty
+ * buffers are discarded
+ */
+void bufl_invalidate(int drv)
+{
+    BCB *b;
+    int i;
+
+    for (i = BI_FAT; i <= BI_DATA; i++)
+    {
+        for (b = bufl[i]; b; b = b->b_link)
+        {
+            if (b->b_bufdrv != drv)
+                continue;
+            b->b_bufdrv = -1;
+#if CONF_WITH_BDOS_CACHE
+            if (is_own(b))
+            {
+                hash_remove((BCBX *)b);
+                lru_make_oldest(&lru[i], (BCBX *)b);
+            }
+#endif
+        }
+    }
+}
+
+
+
+#if CONF_WITH_FAT_WRITEBACK
+/*
+ * next_dirty_fat - find the dirty FAT buffer for the specified drive
+ * with the lowest record number not less than 'rec'
+ */
+static BCB *next_dirty_fat(WORD drv, RECNO rec)
+{
+    BCB *b, *found = NULL;
+
+    for (b = bufl[BI_FAT]; b; b = b->b_link)
+    {
+        if ((b->b_bufdrv == drv) && b->b_dirty && (b->b_bufrec >= rec))
+            if (!found || (b->b_bufrec < found->b_bufrec))
+                found = b;
+    }
+
+    return found;
+}
+
+
+/*
+ * write_fat_copy - write the dirty FAT buffers for a drive to one copy
+ * of the FAT
+ *
+ * 'recoff' is the offset of the FAT copy.  the buffers are written in
+ * ascending record order; runs of consecutive records are merged into
+ * a single write.  if 'clean' is set, the buffers are marked as clean.
+ *
+ * NOTE: longjmp_rwabs() is a macro that includes a longjmp() which is
+ *       executed if the BIOS returns an error; any dirty buffers will
+ *       then be discarded by osif().
+ */
+static void write_fat_copy(DMD *dm, RECNO recoff, BOOL clean)
+{
+    BCB *first, *b;
+    RECNO rec;
+    UBYTE *p;
+    WORD drv = dm->m_drvnum;
+    int n, maxrun;
+
+    maxrun = runbuf ? RUNBUF_SIZE / dm->m_recsiz : 1;
+
+    for (rec = 0; (first = next_dirty_fat(drv, rec)); rec += n)
+    {
+        rec = first->b_bufrec;
+        p = runbuf;
+        for (n = 1; n < maxrun; n++)
+        {
+            b = next_dirty_fat(drv, rec+n);
+            if (!b || (b->b_bufrec != rec+n))
+                break;
+            if (n == 1)
+            {
+                memcpy(p, first->b_bufr, dm->m_recsiz);
+                p += dm->m_recsiz;
+            }
+            memcpy(p, b->b_bufr, dm->m_recsiz);
+            p += dm->m_recsiz;
+            if (clean)
+                b->b_dirty = 0;
+        }
+
+        longjmp_rwabs(1, (long)((n > 1) ? runbuf : first->b_bufr), n, rec+recoff, drv);
+        if (clean)
+            first->b_dirty = 0;
+    }
+}
+
+
+/*
+ * flush_fat - write all dirty FAT buffers for the specified drive,
+ * or for all drives if 'drv' is negative
+ *
+ * the first FAT copy is written completely before the second one, so
+ * that each copy is written in a single ascending sweep.
+ */
+void flush_fat(int drv)
+{
+    BCB *b;
+    DMD *dm;
+
+    for ( ; ; )
+    {
+        /* find a drive with dirty FAT buffers */
+        for (b = bufl[BI_FAT]; b; b = b->b_link)
+            if ((b->b_bufdrv != -1) && b->b_dirty && ((drv < 0) || (b->b_bufdrv == drv)))
+                break;
+        if (!b)
+            break;
+
+        dm = b->b_dm;
+        if (!dm->m_1fat)
+            write_fat_copy(dm, dm->m_recoff[BT_FAT]-dm->m_fsiz, FALSE);
+        write_fat_copy(dm, dm->m_recoff[BT_FAT], TRUE);
+    }
+
+    if (drv < 0)
+        fatdeadline = 0;
 }
+#endif
 
 
 
@@ -87,10 +676,19 @@ void flush(BCB *b)
     int n,d;
     DMD *dm;
 
+#if CONF_WITH_FAT_WRITEBACK
+    if (b->b_buftyp == BT_FAT)
+    {
+        flush_fat(b->b_bufdrv); /* write all dirty FAT buffers for drive */
+        return;
+    }
+#endif
+
     dm = b->b_dm;               /*  media descr for buffer      */
     n = b->b_buftyp;
     d = b->b_bufdrv;
     b->b_bufdrv = -1;           /* invalidate in case of error */
+    BDOS_COUNT(cacheflushes, 1);
 
     longjmp_rwabs(1, (long)b->b_bufr, 1, b->b_bufrec+dm->m_recoff[n], d);
 
@@ -106,6 +704,259 @@ void flush(BCB *b)
 
 
 
+#if CONF_WITH_BDOS_CACHE
+
+/*
+ * getbcb - called by getrec() to get the BCB for the desired record
+ *
+ * buftype is BT_FAT, BT_ROOT, or BT_DATA
+ *
+ * we first look in the hash index of our own buffers.  if the record
+ * is not there, and other programs have added buffers to the chain, we
+ * search those too.  if the record is not found, we read it into an
+ * invalid buffer added by another program (if any), or else into the
+ * least recently used of our own buffers.
+ */
+BCB *getbcb(DMD *dmd,WORD buftype,RECNO recnum)
+{
+    LRULIST *l;
+    BCBX *bx;
+    BCB *b, *p, *mtbuf;
+    WORD drv, list;
+    int err;
+
+    drv = dmd->m_drvnum;
+    list = (buftype == BT_FAT) ? BI_FAT : BI_DATA;
+    l = &lru[list];
+    mtbuf = NULL;
+
+    b = (BCB *)hash_lookup(drv, buftype, recnum);
+
+    if (!b && ((bufl[list] != l->first) || l->last->b_link))
+    {
+        for (p = bufl[list]; p; p = p->b_link)
+        {
+            if (is_own(p))
+                continue;
+            if ((p->b_bufdrv == drv) && (p->b_buftyp == buftype) && (p->b_bufrec == recnum))
+            {
+                b = p;
+                break;
+            }
+            if (p->b_bufdrv == -1)  /* if buffer not valid */
+                mtbuf = p;          /*    then it's 'empty' */
+        }
+    }
+
+    if (b)
+    {   /* use a buffer, but first validate media */
+        err = chkmedia(drv);
+        if (err == 0)
+        {
+            if (is_own(b))
+                lru_make_newest(l, (BCBX *)b);
+            BDOS_COUNT(cachehits, 1);
+            return b;
+        }
+        if (err == 2)
+        {
+            /* media definitely changed */
+            errdrv = drv;
+            rwerr = E_CHNG; /* media change */
+            errcode = rwerr;
+            longjmp(errbuf,1);
+        }
+        /* media may be changed: re-read the record into the same buffer */
+    }
+    else if (mtbuf)
+        b = mtbuf;
+    else b = &l->oldest->bx_bcb;
+
+    bx = is_own(b) ? (BCBX *)b : NULL;
+    if (bx)
+        hash_remove(bx);
+
+    /*
+     * if the buffer is dirty, flush it, then read in the new record
+     */
+    if ((b->b_bufdrv != -1) && b->b_dirty)
+        flush(b);
+    b->b_bufdrv = -1;       /* in case longjmp_rwabs() fails */
+    BDOS_COUNT(cachemisses, 1);
+    longjmp_rwabs(0, (long)b->b_bufr, 1, recnum+dmd->m_recoff[buftype], drv);
+
+    /*
+     * make the new buffer current
+     */
+    b->b_bufrec = recnum;
+    b->b_dirty = 0;
+    b->b_buftyp = buftype;
+    b->b_bufdrv = drv;
+    b->b_dm = dmd;
+
+    if (bx)
+    {
+        hash_insert(bx);
+        lru_make_newest(l, bx);
+    }
+
+    return b;
+}
+
+
+#if CONF_WITH_READAHEAD
+/*
+ * readahead_wanted - TRUE if data record 'recn' of the drive is not in the
+ * cache, and readahead() could read it
+ *
+ * this is cheap, so the caller can check it before working out how far
+ * to read ahead
+ */
+BOOL readahead_wanted(DMD *dm, RECNO recn)
+{
+    LRULIST *l = &lru[BI_DATA];
+
+    if (!runbuf || (bufl[BI_DATA] != l->first) || l->last->b_link)
+        return FALSE;
+
+    return hash_lookup(dm->m_drvnum, BT_DATA, recn) == NULL;
+}
+
+/*
+ * readahead - read data records into the cache before they are needed
+ *
+ * reads up to 'n' consecutive data records of the drive, starting with
+ * 'recn', with a single Rwabs() via the run buffer, and copies them into
+ * the least recently used dir/data buffers.  the run stops before the
+ * first record that is already cached, so cached (possibly dirty) data
+ * is never replaced.
+ *
+ * returns the number of records read
+ */
+WORD readahead(DMD *dm, RECNO recn, WORD n)
+{
+    LRULIST *l = &lru[BI_DATA];
+    BCBX *bx;
+    BCB *b;
+    UBYTE *p;
+    WORD drv, i;
+
+    /* we can't check buffers added by other programs efficiently */
+    if (!runbuf || (bufl[BI_DATA] != l->first) || l->last->b_link)
+        return 0;
+
+    if (n > RUNBUF_SIZE / dm->m_recsiz)
+        n = RUNBUF_SIZE / dm->m_recsiz;
+    if (n > numbcbx / 4)    /* don't flood the cache */
+        n = numbcbx / 4;
+
+    drv = dm->m_drvnum;
+    for (i = 0; i < n; i++)
+        if (hash_lookup(drv, BT_DATA, recn+i))
+            break;
+    n = i;
+    if (n < 2)              /* getbcb() can do this just as well */
+        return 0;
+
+    KDEBUG(("readahead(%d): recs %ld->%ld\n",drv,recn,recn+n-1));
+    BDOS_COUNT(readaheads, n);
+    longjmp_rwabs(0, (long)runbuf, n, recn+dm->m_recoff[BT_DATA], drv);
+
+    for (i = 0, p = runbuf; i < n; i++, p += dm->m_recsiz)
+    {
+        bx = l->oldest;
+        b = &bx->bx_bcb;
+        hash_remove(bx);
+        if ((b->b_bufdrv != -1) && b->b_dirty)
+            flush(b);
+        memcpy(b->b_bufr, p, dm->m_recsiz);
+        b->b_bufrec = recn + i;
+        b->b_dirty = 0;
+        b->b_buftyp = BT_DATA;
+        b->b_bufdrv = drv;
+        b->b_dm = dm;
+        hash_insert(bx);
+        lru_make_newest(l, bx);
+    }
+
+    return n;
+}
+#endif
+
+
+/*
+ * sync_direct - bring a cached record in line with a direct transfer
+ *
+ * 'p' points to the record in the user buffer.  after a read, the user
+ * buffer gets the cached contents if they are dirty (i.e. newer than
+ * what was read).  after a write, the cached copy gets the new contents,
+ * which are now on disk.
+ */
+static void sync_direct(BCB *b, int rwflg, UBYTE *p, UWORD recsiz)
+{
+    if (rwflg)
+    {
+        memcpy(b->b_bufr, p, recsiz);
+        b->b_dirty = 0;
+    }
+    else if (b->b_dirty)
+        memcpy(p, b->b_bufr, recsiz);
+}
+
+
+/*
+ * bufl_direct - keep the cache coherent after a direct transfer
+ *
+ * called by usrio() after it has transferred 'num' data records starting
+ * with 'strt' directly between the disk and 'ubuf'.  cached copies of
+ * those records stay valid (see sync_direct()).  they are found via the
+ * hash index, or via the LRU list if that is shorter than the transfer.
+ */
+void bufl_direct(DMD *dm, int rwflg, RECNO strt, int num, UBYTE *ubuf)
+{
+    LRULIST *l = &lru[BI_DATA];
+    BCBX *bx;
+    BCB *b;
+    WORD drv;
+    int i;
+
+    drv = dm->m_drvnum;
+
+    if (num < numbcbx)
+    {
+        for (i = 0; i < num; i++)
+        {
+            bx = hash_lookup(drv, BT_DATA, strt+i);
+            if (bx)
+                sync_direct(&bx->bx_bcb, rwflg, ubuf+((LONG)i<<dm->m_rblog), dm->m_recsiz);
+        }
+    }
+    else
+    {
+        for (bx = l->newest; bx; bx = bx->bx_older)
+        {
+            b = &bx->bx_bcb;
+            if ((b->b_bufdrv == drv) && (b->b_buftyp == BT_DATA)
+             && (b->b_bufrec >= strt) && (b->b_bufrec < strt+num))
+                sync_direct(b, rwflg, ubuf+((b->b_bufrec-strt)<<dm->m_rblog), dm->m_recsiz);
+        }
+    }
+
+    /* buffers added by other programs */
+    if ((bufl[BI_DATA] == l->first) && !l->last->b_link)
+        return;
+    for (b = bufl[BI_DATA]; b; b = b->b_link)
+    {
+        if (is_own(b))
+            continue;
+        if ((b->b_bufdrv == drv) && (b->b_buftyp == BT_DATA)
+         && (b->b_bufrec >= strt) && (b->b_bufrec < strt+num))
+            sync_direct(b, rwflg, ubuf+((b->b_bufrec-strt)<<dm->m_rblog), dm->m_recsiz);
+    }
+}
+
+#else
+
 /*
  * getbcb - called by getrec() to get the BCB for the desired record
  *
@@ -162,6 +1013,7 @@ doio:   for (p = *(q = phdr); p->b_link; p = *(q = &p->b_link))
         if ((b->b_bufdrv != -1) && b->b_dirty)
             flush(b);
         b->b_bufdrv = -1;       /* in case longjmp_rwabs() fails */
+        BDOS_COUNT(cachemisses, 1);
         longjmp_rwabs(0, (long)b->b_bufr, 1, recnum+dmd->m_recoff[buftype], dmd->m_drvnum);
 
         /*
@@ -176,8 +1028,10 @@ doio:   for (p = *(q = phdr); p->b_link; p = *(q = &p->b_link))
     }
     else
     {   /* use a buffer, but first validate media */
-        err = Mediach(b->b_bufdrv);
-        if (err != 0) {
+        err = chkmedia(b->b_bufdrv);
+        if (err == 0)
+            BDOS_COUNT(cachehits, 1);
+        else {
             if (err == 1) {
                 goto doio; /* media may be changed */
             } else if (err == 2) {
@@ -201,6 +1055,8 @@ doio:   for (p = *(q = phdr); p->b_link; p = *(q = &p->b_link))
     return b;
 }
 
+#endif /* CONF_WITH_BDOS_CACHE */
+
 
 
 /*
@@ -214,6 +1070,12 @@ UBYTE *getrec(RECNO recn, OFD *of, int wrtflg)
 
     KDEBUG(("getrec 0x%lx, %p, 0x%x\n",recn,dm,wrtflg));
 
+#if CONF_WITH_FAT_WRITEBACK
+    /* don't let FAT updates stay unwritten for too long */
+    if (fatdeadline && (hz_200 - fatdeadline >= 0))
+        flush_fat(-1);
+#endif
+
     /* put bcb management here */
     if (of->o_dmd->m_fatofd == of)  /* is this the OFD for the 'FAT file'? */
         n = BT_FAT;                 /* yes, must be FAT access             */
@@ -229,7 +1091,13 @@ UBYTE *getrec(RECNO recn, OFD *of, int wrtflg)
      * if we are writing to the buffer, dirty it
      */
     if (wrtflg)
+    {
         b->b_dirty = 1;
+#if CONF_WITH_FAT_WRITEBACK
+        if ((n == BT_FAT) && !fatdeadline)
+            fatdeadline = (hz_200 + CONF_FAT_WRITEBACK_SECS*CLOCKS_PER_SEC) | 1;
+#endif
+    }
 
     return b->b_bufr;
 }
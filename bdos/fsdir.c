@@ -131,6 +131,7 @@
 #include "biosbind.h"
 #include "string.h"
 #include "bdosstub.h"
+#include "biosext.h"
 
 #include "miscutil.h"
 
@@ -167,9 +168,15 @@ static BOOL is_subdir(const char *s1,DND *dn1, DND *dn2);
 static const char dots[22] = ".          ";
 
 /*
- *  counter used by free_available_dnds()
+ *  DNDs stay in the tree until the os memory pool runs out.  then
+ *  free_available_dnds() frees the least recently used ones that are not
+ *  needed.  dnd_clock provides the d_used stamps.
  */
-static LONG freed_dnds, freed_ofds; /* count of DNDs & OFDs made available */
+static ULONG dnd_clock;
+
+#define DND_EVICT_BATCH 8   /* max DNDs freed by free_available_dnds() */
+
+#define touchdnd(dnd)   ((dnd)->d_used = ++dnd_clock)
 
 
 /*
@@ -676,6 +683,64 @@ long xsnext(void)
 }
 
 
+#if CONF_WITH_FSNEXTN
+/*
+ *  xsnextn - search next, return multiple entries into buffer
+ *
+ *  Function 0x1D   Fsnextn (EmuTOS extension)
+ *
+ *  Like calling Fsnext() up to 'count' times, storing each entry found
+ *  into the next element of 'buf'.  As for Fsnext(), the search state is
+ *  kept in the private area of the current DTA, so a search may be resumed
+ *  later from a saved copy of the DTA.  On return, the DTA holds the last
+ *  entry found.
+ *
+ *  Returns the number of entries stored (0 if count is not positive)
+ *
+ *  Error returns:  ENMFIL
+ */
+long xsnextn(DTAENTRY *buf, int count)
+{
+    FCB *fcb;
+    DTAINFO *dt;
+    int n;
+
+    /*
+     * if some other program has hooked GEMDOS (e.g. to provide its own
+     * drives), the DTA may be in its format rather than ours, so we let
+     * the caller use Fsnext() instead
+     */
+    if (Setexc(0x21, -1L) != (LONG)enter)
+        return EINVFN;
+
+    dt = (DTAINFO *)run->p_xdta;
+
+    for (n = 0; n < count; n++, buf++)
+    {
+        if (dt->dt_offset_drive < 0L)       /* uninitialised or finished */
+            break;
+
+        fcb = ixsnext(dt);
+        if (fcb == NULL)                    /* end of directory */
+        {
+            dt->dt_offset_drive = -1L;
+            break;
+        }
+
+        makbuf(fcb, dt);
+        memcpy(&buf->d_attrib, &dt->dt_fattr, sizeof(DTAENTRY)-1);
+    }
+
+    KDEBUG(("xsnextn(%p,%d): %d entries\n",buf-n,count,n));
+
+    if ((n == 0) && (count > 0))
+        return ENMFIL;
+
+    return n;
+}
+#endif
+
+
 /*
  *  xgsdtof - get/set date/time of file into or from buffer
  *
@@ -1025,6 +1090,9 @@ long xrename(int n, char *p1, char *p2)
             KDEBUG(("xrename(): can't erase old entry\n"));
             return EACCDN;
         }
+#if CONF_WITH_DIRINDEX
+        dirindex_free(dn1,posp);
+#endif
 
         /* copy the time/date/cluster/length to the OFD */
         dfd = fd2->o_dfd;
@@ -1080,6 +1148,9 @@ long xrename(int n, char *p1, char *p2)
             KDEBUG(("xrename(): can't update FCB with new name\n"));
             return EACCDN;
         }
+#if CONF_WITH_DIRINDEX
+        dirindex_add(dn1,posp,buf);
+#endif
     }
 
     /*
@@ -1410,6 +1481,7 @@ DND *findit(char *name, const char **sp, int dflag)
     const char *n;
     DND *pp, *newp;
     int i;
+    BOOL scanned;
     char s[FNAMELEN], *q;
 
     /* crack directory and drive */
@@ -1455,11 +1527,13 @@ DND *findit(char *name, const char **sp, int dflag)
          *     which is the first child.
          */
         pp = p;                 /*  save ptr to parent DND      */
+        scanned = FALSE;
 
         if (!(newp = p->d_left))
         {                               /*  [1] [see below]     */
                                         /*  make sure children  */
             newp = dirscan(p,n);        /*  are logged in       */
+            scanned = TRUE;
         }
 
         if (!(p = newp))        /*  If no children, exit loop */
@@ -1480,11 +1554,19 @@ DND *findit(char *name, const char **sp, int dflag)
                 p = 0;
                 if (pp)
                     p = dirscan(pp,n);
+                scanned = TRUE;
             }
             else
                 p = newp;
         }
 
+        if (scanned)
+            BDOS_COUNT(dndmisses, 1);
+        else
+            BDOS_COUNT(dndhits, 1);
+        if (p)
+            touchdnd(p);
+
     scanxt:
     if (*(n = n + i))
         n++;
@@ -1505,9 +1587,9 @@ DND *findit(char *name, const char **sp, int dflag)
  *      However, we need to call dirscan if children are logged in and we still
  *      didn't find the desired node, as the desired child may've been flushed.
  *      This is a terrible thing to have happen to a child.  However, we can't
- *      afford to have all these kids around here, so when new ones come in, we
- *      see which we can flush out (see makdnd()).  This is a hack -- no doubt
- *      about that; the cached DND scheme needs to be redesigned all around.
+ *      afford to have all these kids around here, so when the os memory pool
+ *      runs out, the least recently used ones are flushed out (see
+ *      free_available_dnds()).
  *      Anyway, the second call to dirscan backs up to the parent (note that n
  *      has not yet been bumped, so is still pointing to the current subdir's
  *      name -- in effect, starting us at this level all over again.
@@ -1515,6 +1597,386 @@ DND *findit(char *name, const char **sp, int dflag)
  */
 
 
+#if CONF_WITH_DIRINDEX
+/*
+ *  directory name index
+ *
+ *  for each of a few large directories, we keep a hash table of the names
+ *  it contains.  a table slot holds the 16-bit hash of a name in the high
+ *  word and its entry number + 1 in the low word; 0 means the slot is empty.
+ *  collisions use linear probing.  a name found via the index is always
+ *  checked against the directory itself, so stale slots do no harm, but
+ *  every name that is added to a directory must be passed to dirindex_add().
+ *
+ *  di_free is the lowest entry number that may be free, which saves
+ *  ixcreat() from scanning the whole directory for an empty slot.  it is
+ *  updated by dirindex_free() and by the free slot scan itself.
+ *
+ *  di_end is the entry number of the end of directory marker (or the
+ *  number of entries, if there is none), so that a lookup which fails
+ *  can leave the directory positioned like a scan through it would.
+ *
+ *  the index is not part of the DND (which is limited in size and may be
+ *  scavenged at any time), but is identified by the drive and the starting
+ *  cluster of the directory.
+ *
+ *  the tables are taken from a pool of ST-RAM reserved at boot by
+ *  dirindex_init(), then from alt-RAM, like the free cluster bitmaps (see
+ *  fsfat.c), and never from the ST-RAM user pool.  the pool is kept
+ *  compact by moving the tables down when one is released.
+ */
+#define NUM_DIRINDEX    4
+#define DI_MAXENTS      0x7fffL     /* max entries in an indexed directory */
+#define DI_INPOOL(p)    (((UBYTE *)(p) >= di_pool) && ((UBYTE *)(p) < di_pool+di_poolsize))
+
+typedef struct
+{
+    DMD   *di_dmd;          /*  drive, or NULL if unused            */
+    CLNO  di_strtcl;        /*  starting cluster of directory       */
+    UWORD di_free;          /*  lowest entry that may be free       */
+    UWORD di_mask;          /*  number of slots - 1                 */
+    UWORD di_used;          /*  number of slots in use              */
+    UWORD di_end;           /*  end of directory marker entry       */
+    ULONG di_lru;           /*  time of last use                    */
+    ULONG *di_hash;         /*  the slots                           */
+} DIRINDEX;
+
+static DIRINDEX dirindex[NUM_DIRINDEX];
+static ULONG dirindex_clock;
+static UBYTE *di_pool;          /* the pool reserved at boot */
+static LONG di_poolsize;
+static LONG di_poolused;        /* bytes at the start of the pool in use */
+
+
+/*
+ *  dirindex_init - reserve the pool for the index tables
+ *
+ *  like bufl_init(), this must be called before memory is initialised
+ */
+void dirindex_init(void)
+{
+    di_poolsize = CONF_DIRINDEX_STRAM_SIZE;
+    if (di_poolsize)
+        di_pool = balloc_stram(di_poolsize, FALSE);
+}
+
+
+/*
+ *  dirindex_alloc - allocate a table, from the pool if there is room
+ */
+static ULONG *dirindex_alloc(LONG size)
+{
+    ULONG *p;
+
+    if (di_poolused + size <= di_poolsize)
+    {
+        p = (ULONG *)(di_pool + di_poolused);
+        di_poolused += size;
+        return p;
+    }
+
+    p = xmxalloc(size, MX_TTRAM);
+    if (p)
+        set_owner(p, NULL);     /* must survive the current process */
+
+    return p;
+}
+
+
+/*
+ *  dirindex_hash - hash an 11-character name, ignoring case
+ */
+static UWORD dirindex_hash(const char *s)
+{
+    UWORD h;
+    int i;
+
+    for (i = 0, h = 0; i < FNAMELEN; i++)
+        h = (h << 5) + h + toupper((UBYTE)*s++);
+
+    return h;
+}
+
+
+/*
+ *  dirindex_key - get the starting cluster that identifies a directory
+ *  (see comments in xrename() for the purpose of ROOT_PSEUDO_CLUSTER)
+ */
+static CLNO dirindex_key(DND *dn)
+{
+    return dn->d_parent ? dn->d_strtcl : ROOT_PSEUDO_CLUSTER;
+}
+
+
+/*
+ *  dirindex_get - get the index for a directory, or NULL if there is none
+ */
+static DIRINDEX *dirindex_get(DND *dn)
+{
+    DIRINDEX *di;
+    CLNO cl;
+
+    cl = dirindex_key(dn);
+    for (di = dirindex; di < dirindex+NUM_DIRINDEX; di++)
+    {
+        if ((di->di_dmd == dn->d_drv) && (di->di_strtcl == cl))
+        {
+            di->di_lru = ++dirindex_clock;
+            return di;
+        }
+    }
+
+    return NULL;
+}
+
+
+/*
+ *  dirindex_release - free an index
+ */
+static void dirindex_release(DIRINDEX *di)
+{
+    UBYTE *p = (UBYTE *)di->di_hash;
+    DIRINDEX *d;
+    LONG size;
+
+    di->di_hash = NULL;
+    di->di_dmd = NULL;
+    if (!p)
+        return;
+
+    if (!DI_INPOOL(p))
+    {
+        xmfree(p);
+        return;
+    }
+
+    /* close the gap, and move the tables above it down */
+    size = (di->di_mask + 1L) * sizeof(ULONG);
+    memmove(p, p+size, di_pool+di_poolused-(p+size));
+    di_poolused -= size;
+
+    for (d = dirindex; d < dirindex+NUM_DIRINDEX; d++)
+        if (d->di_hash && DI_INPOOL(d->di_hash) && ((UBYTE *)d->di_hash > p))
+            d->di_hash = (ULONG *)((UBYTE *)d->di_hash - size);
+}
+
+
+/*
+ *  dirindex_drop - free the index of the directory starting at cluster cl
+ *  on drive dm.  a cluster of 0 means all directories on the drive, and
+ *  a NULL drive means all drives.
+ */
+void dirindex_drop(DMD *dm, CLNO cl)
+{
+    DIRINDEX *di;
+
+    for (di = dirindex; di < dirindex+NUM_DIRINDEX; di++)
+    {
+        if (!di->di_dmd)
+            continue;
+        if ((!dm || (di->di_dmd == dm)) && (!cl || (di->di_strtcl == cl)))
+            dirindex_release(di);
+    }
+}
+
+
+/*
+ *  dirindex_insert - add entry number ent, with name hash h, to an index
+ *
+ *  returns FALSE if the table is too full
+ */
+static BOOL dirindex_insert(DIRINDEX *di, UWORD h, UWORD ent)
+{
+    ULONG e;
+    UWORD i;
+
+    e = ((ULONG)h << 16) | (ent + 1);
+    for (i = h & di->di_mask; di->di_hash[i]; i = (i + 1) & di->di_mask)
+        if (di->di_hash[i] == e)
+            return TRUE;
+
+    if (di->di_used >= di->di_mask - (di->di_mask >> 2))
+        return FALSE;
+
+    di->di_hash[i] = e;
+    di->di_used++;
+
+    return TRUE;
+}
+
+
+/*
+ *  dirindex_build - build the index for a directory
+ *
+ *  if there is not enough memory, the directory is simply not indexed.
+ */
+static void dirindex_build(DND *dn, OFD *fd)
+{
+    DIRINDEX *di, *p;
+    DMD *dm;
+    FCB *fcb;
+    CLNO cl;
+    LONG ents, size;
+    UWORD n, free;
+
+    /*
+     *  find out how many entries the directory can hold
+     */
+    dm = dn->d_drv;
+    if (!dn->d_parent)
+        ents = fd->o_dfd->o_fileln / sizeof(FCB);
+    else for (ents = 0, cl = dn->d_strtcl; (cl >= 2) && !endofchain(cl); cl = getrealcl(cl,dm))
+    {
+        ents += dm->m_clsizb / sizeof(FCB);
+        if (ents > DI_MAXENTS)
+            return;
+    }
+
+    for (size = 4; size < 2*ents; size <<= 1)
+        ;
+
+    /*
+     *  use an unused index, else the least recently used one
+     */
+    for (di = p = dirindex; p < dirindex+NUM_DIRINDEX; p++)
+    {
+        if (!p->di_dmd)
+        {
+            di = p;
+            break;
+        }
+        if (p->di_lru < di->di_lru)
+            di = p;
+    }
+    dirindex_release(di);
+
+    di->di_hash = dirindex_alloc(size*sizeof(ULONG));
+    if (!di->di_hash)
+        return;
+    bzero(di->di_hash, size*sizeof(ULONG));
+    di->di_mask = size - 1;
+    di->di_used = 0;
+
+    /*
+     *  read through the directory.  note that ixgetfcb() may longjmp
+     *  on an error, so the index is only marked as valid at the end.
+     */
+    free = 0xffff;
+    ixlseek(fd, 0L);
+    for (n = 0; (fcb = ixgetfcb(fd)) && fcb->f_name[0]; n++)
+    {
+        if (fcb->f_name[0] == ERASE_MARKER)
+        {
+            if (n < free)
+                free = n;
+            continue;
+        }
+        if (fcb->f_attrib == FA_LFN)
+            continue;
+        if (!dirindex_insert(di, dirindex_hash(fcb->f_name), n))
+        {
+            dirindex_release(di);
+            return;
+        }
+    }
+
+    di->di_free = (n < free) ? n : free;
+    di->di_end = n;
+    di->di_strtcl = dirindex_key(dn);
+    di->di_lru = ++dirindex_clock;
+    di->di_dmd = dm;
+
+    KDEBUG(("dirindex_build(): %u entries in %ld slots\n",n,size));
+}
+
+
+/*
+ *  dirindex_lookup - look up an exact name in an index
+ *
+ *  returns the matching FCB with the lowest entry number not less than
+ *  start (with the directory positioned after it), or NULL (with the
+ *  directory positioned after its end marker, as a scan would leave it)
+ */
+static FCB *dirindex_lookup(DIRINDEX *di, OFD *fd, char *name, UWORD start)
+{
+    FCB *fcb;
+    ULONG e;
+    UWORD h, i, ent, best;
+
+    h = dirindex_hash(name);
+    best = 0xffff;
+    for (i = h & di->di_mask; (e = di->di_hash[i]); i = (i + 1) & di->di_mask)
+    {
+        if ((UWORD)(e >> 16) != h)
+            continue;
+        ent = (UWORD)e - 1;
+        if ((ent < start) || (ent >= best))
+            continue;
+        ixlseek(fd, (LONG)ent * sizeof(FCB));
+        fcb = ixgetfcb(fd);
+        if (fcb && match(name, fcb->f_name))
+            best = ent;
+    }
+
+    if (best == 0xffff)
+    {
+        ent = (start > di->di_end) ? start : di->di_end;
+        ixlseek(fd, (LONG)ent * sizeof(FCB));
+        ixgetfcb(fd);
+        return NULL;
+    }
+
+    ixlseek(fd, (LONG)best * sizeof(FCB));
+    return ixgetfcb(fd);
+}
+
+
+/*
+ *  dirindex_add - record that the name at offset pos in a directory
+ *  has been set to name
+ */
+void dirindex_add(DND *dn, LONG pos, const char *name)
+{
+    DIRINDEX *di;
+    UWORD ent;
+
+    di = dirindex_get(dn);
+    if (!di)
+        return;
+
+    ent = pos / sizeof(FCB);
+    if (!dirindex_insert(di, dirindex_hash(name), ent))
+    {
+        dirindex_release(di);   /* rebuilt by the next long scan */
+        return;
+    }
+    if (ent == di->di_free)
+        di->di_free++;
+    if (ent >= di->di_end)
+        di->di_end = ent + 1;
+}
+
+
+/*
+ *  dirindex_free - record that the entry at offset pos in a directory
+ *  has been erased
+ */
+void dirindex_free(DND *dn, LONG pos)
+{
+    DIRINDEX *di;
+    UWORD ent;
+
+    di = dirindex_get(dn);
+    if (!di)
+        return;
+
+    ent = pos / sizeof(FCB);
+    if (ent < di->di_free)
+        di->di_free = ent;
+}
+#endif /* CONF_WITH_DIRINDEX */
+
+
 /*
  *  scan - scan a directory for an entry with the desired name.
  *      scans a directory indicated by a DND.  attributes figure in matching
@@ -1528,7 +1990,14 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
     FCB *fcb;
     OFD *fd;
     DND *dnd1;
+    UWORD locked;
     BOOL m;                 /*  T: found a matching FCB             */
+#if CONF_WITH_DIRINDEX
+    DIRINDEX *di;
+    LONG start;
+    UWORD count;
+    int i;
+#endif
 
     KDEBUG(("scan(%p,'%s',0x%x,%p)\n",dnd,n,att,posp));
 
@@ -1545,17 +2014,57 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
     if (!(fd = dnd->d_ofd))
         fd = makofd(dnd);   /* makofd() also updates dnd->d_ofd */
 
+    /*
+     *  makdnd() may need to free a DND, which must not be this one
+     */
+    locked = dnd->d_flag & DND_LOCKED;
+    dnd->d_flag |= DND_LOCKED;
+
+#if CONF_WITH_DIRINDEX
+    start = (*posp == -1) ? 0L : *posp;
+    di = dirindex_get(dnd);
+    if (di)
+    {
+        /*
+         *  an exact name can be looked up in the index.  when looking
+         *  for a free slot, we can skip the entries known to be in use.
+         */
+        for (i = 0; i < FNAMELEN; i++)
+            if (name[i] == '?')
+                break;
+        if ((i == FNAMELEN) && (*name != ERASE_MARKER))
+        {
+            fcb = dirindex_lookup(di, fd, name, start / sizeof(FCB));
+            if (fcb && (fcb->f_attrib & FA_SUBDIR) && (fcb->f_name[0] != '.'))
+            {
+                dnd1 = getdnd(&fcb->f_name[0], dnd);
+                if (!dnd1)
+                    dnd1 = makdnd(dnd,fcb);   /* always succeeds */
+            }
+            m = fcb ? TRUE : FALSE;
+            goto found;
+        }
+        if ((*name == ERASE_MARKER) && (start < di->di_free * sizeof(FCB)))
+            start = di->di_free * sizeof(FCB);
+    }
+    ixlseek(fd, start);
+    count = 0;
+#else
     /*
      *  seek to desired starting position.  If posp == -1, then start at
      *  the beginning.
      */
     ixlseek(fd, (*posp == -1) ? 0L : *posp);
+#endif
 
     /*
      *  scan thru the directory file, looking for a match
      */
     while ((fcb = ixgetfcb(fd)) && (fcb->f_name[0]))
     {
+#if CONF_WITH_DIRINDEX
+        count++;
+#endif
         /*
          *  Add New DND.
          *  ( iff after scan ptr && not a .
@@ -1574,6 +2083,34 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
              break;
     }
 
+#if CONF_WITH_DIRINDEX
+    /*
+     *  note that makdnd() may have dropped the index, so we look it up
+     *  again.  after building an index, we must re-read the FCB, since
+     *  its buffer may have been reused.
+     */
+    di = dirindex_get(dnd);
+    if (di)
+    {
+        if (fcb && (*name == ERASE_MARKER))
+            di->di_free = (fd->o_bytnum - sizeof(FCB)) / sizeof(FCB);
+    }
+    else if (count >= CONF_DIRINDEX_MIN)
+    {
+        start = fd->o_bytnum;
+        dirindex_build(dnd, fd);
+        if (fcb)
+        {
+            ixlseek(fd, start - sizeof(FCB));
+            fcb = ixgetfcb(fd);
+        }
+        else ixlseek(fd, start);
+    }
+
+found:
+#endif
+    dnd->d_flag &= ~DND_LOCKED | locked;
+
     KDEBUG(("\n   scan(pos=%ld DND=%p DNDfoundFile=%p name=%s name=%s, %d)",
             (long)fd->o_bytnum,dnd,dnd1,fcb?fcb->f_name:"(null)",name,m));
 
@@ -1609,64 +2146,23 @@ FCB *scan(DND *dnd, const char *n, WORD att, LONG *posp)
  */
 static DND *makdnd(DND *p, FCB *fcb)
 {
-    DIRTBL_ENTRY *dt;
     DND *p1;
-    DND **prev;
     OFD *fd;
-    int i;
 
     fd = p->d_ofd;
 
     /*
-     *  scavenge a DND at this level if we can find one that has not
-     *  d_left
+     *  if the os memory pool runs out, MGET() frees the least recently
+     *  used DNDs (see free_available_dnds()).  p is locked by scan().
      */
-    for (prev = &p->d_left; (p1 = *prev); prev = &p1->d_right)
-    {
-        if (!p1->d_left)
-        {
-            /* do not scavenge if it's locked */
-            if (p1->d_flag & DND_LOCKED)
-                continue;
-
-            /* check dirtbl[] to see if anyone is using this guy */
-            for (i = 1, dt = dirtbl+1; i < NCURDIR; i++, dt++)
-                if (dt->use && (dt->dnd == p1))
-                    break;
-
-            KDEBUG(("\n makdnd check dirtbl (%d)",i));
-
-            if ((i >= NCURDIR) && (p1->d_files == NULL))
-            {       /*  M01.01.KTB.SCC.02  */
-                /* clean out this DND for reuse */
-
-                p1->d_flag = 0;
-                p1->d_scan = 0L;
-                p1->d_files = (OFD *) 0;
-                if (p1->d_ofd)
-                    xmfreblk(p1->d_ofd);
-                break;
-            }
-        }
-    }
-
-    /* we didn't find one that qualifies, so allocate a new one */
+    p1 = MGET(DND); /* MGET(DND) only returns if it succeeds */
 
-    if (!p1)
-    {
-        KDEBUG(("\n makdnd new"));
-
-        p1 = MGET(DND); /* MGET(DND) only returns if it succeeds */
-
-        /* do this init only on a newly allocated DND */
-        p1->d_right = p->d_left;
-        p->d_left = p1;
-        p1->d_parent = p;
-    }
+    p1->d_right = p->d_left;
+    p->d_left = p1;
+    p1->d_parent = p;
 
     /* complete the initialization */
 
-    p1->d_ofd = (OFD *) 0;
     p1->d_strtcl = fcb->f_clust;
     swpw(p1->d_strtcl);
     p1->d_drv = p->d_drv;
@@ -1675,6 +2171,7 @@ static DND *makdnd(DND *p, FCB *fcb)
     p1->d_td.time = fcb->f_td.time; /* note: DND time/date are  */
     p1->d_td.date = fcb->f_td.date; /*  actually little-endian! */
     memcpy(p1->d_name, fcb->f_name, FNAMELEN);
+    touchdnd(p1);
 
     KDEBUG(("\n makdnd(%p)",p1));
 
@@ -1921,16 +2418,18 @@ OFD *makofd(DND *p)
 {
     OFD *f;
     DFD *dfd;
+    UWORD locked;
 
     /*
      * if we run out of memory when allocating the OFD, xmgetblk()
      * will run free_available_dnds() behind our backs.  we mustn't
      * let it free up the DND for which we're allocating an OFD!
-     * so we lock the DND first.
+     * so we lock the DND first (unless our caller already did).
      */
+    locked = p->d_flag & DND_LOCKED;
     p->d_flag |= DND_LOCKED;    /* can't let this DND be scavenged! */
     f = MGET(OFD);              /* MGET(OFD) only returns if it succeeds */
-    p->d_flag &= ~DND_LOCKED;   /* ok, we're safe again */
+    p->d_flag &= ~DND_LOCKED | locked;  /* ok, we're safe again */
 
     p->d_ofd = f;       /* update pointer in DND */
 
@@ -1952,123 +2451,102 @@ OFD *makofd(DND *p)
 
 
 /*
- * function used by free_available_dnds()
+ * function used by free_available_dnds(): adds the DNDs that may be
+ * freed in the tree starting at dndstart to lru[], which holds the *n
+ * least recently used ones found so far, oldest first
  */
-static void process_dnd_tree(DND *dndstart)
+static void lru_dnds(DND *dndstart, DND **lru, WORD *n)
 {
-    DND *dnd, *prev;
+    DND *dnd;
     DIRTBL_ENTRY *dt;
     WORD i;
 
     /*
      * follow the sibling chain
      */
-    for (dnd = dndstart, prev = NULL; dnd; dnd = dnd->d_right) {
+    for (dnd = dndstart; dnd; dnd = dnd->d_right) {
         /*
-         * if child exists, first process the tree based on that child
-         */
-        if (dnd->d_left)
-            process_dnd_tree(dnd->d_left);
-
-        /*
-         * check again, since above we may have freed up the entire child tree
+         * a DND with children cannot be freed, but its children may
          */
         if (dnd->d_left) {
-            KDEBUG(("DND at %p has children\n",dnd));
-            prev = dnd;
+            lru_dnds(dnd->d_left, lru, n);
             continue;
         }
 
         /*
-         * no children - but are there open files?
+         * not if it's younger than all the current candidates, or if it
+         * is a root directory, locked, or has open files
          */
-        if (dnd->d_files) {     /* open files in this directory, can't free DND */
-            KDEBUG(("DND at %p has open files\n",dnd));
-            prev = dnd;
+        if ((*n == DND_EVICT_BATCH) && (dnd->d_used >= lru[*n-1]->d_used))
+            continue;
+        if (!dnd->d_parent || (dnd->d_flag&DND_LOCKED) || dnd->d_files)
             continue;
-        }
 
         /*
-         * no open files - but is this anyone's current dir?
+         * not if it's anyone's current directory
          */
         for (i = 1, dt = dirtbl+1; i < NCURDIR; i++, dt++)
             if (dt->use && (dt->dnd == dnd))
                 break;
-        if (i < NCURDIR) {      /* it's someone's current directory */
-            KDEBUG(("DND at %p is a current directory\n",dnd));
-            prev = dnd;
-            continue;
-        }
-
-        /*
-         * not current - but are we at the root?
-         */
-        if (!dnd->d_parent) {
-            KDEBUG(("DND at %p is a root directory\n",dnd));
-            prev = dnd;
-            continue;
-        }
-
-        /*
-         * not at the root - but are we locked?
-         */
-        if (dnd->d_flag&DND_LOCKED) {
-            KDEBUG(("DND at %p is locked\n",dnd));
-            prev = dnd;
+        if (i < NCURDIR)
             continue;
-        }
 
         /*
-         * we've got a freeable DND
-         *
-         * if there was a previous sibling, link it to the next
-         * else point the parent to the next & say there's no previous
+         * insert it in age order, dropping the youngest if full
          */
-        if (prev) {
-            prev->d_right = dnd->d_right;
-        } else {
-            dnd->d_parent->d_left = dnd->d_right;
-            prev = NULL;
-        }
-
-        /*
-         * now we can free up the DND and any associated OFD
-         */
-        if (dnd->d_ofd) {
-            xmfreblk(dnd->d_ofd);
-            freed_ofds++;
-        }
-        xmfreblk(dnd);
-        freed_dnds++;
+        if (*n < DND_EVICT_BATCH)
+            (*n)++;
+        for (i = *n - 1; (i > 0) && (lru[i-1]->d_used > dnd->d_used); i--)
+            lru[i] = lru[i-1];
+        lru[i] = dnd;
     }
 }
 
 
 /*
  * the following routine is called (by xmgetblk() in osmem.c) when we
- * cannot get memory for a DND or OFD.  it calls process_dnd_tree() to
- * free up DNDs that are not absolutely required (this is the same idea
- * as the "scavenge" procedure in makdnd() above).
+ * cannot get memory for a DND, OFD or MDBLOCK.  it frees the least
+ * recently used DNDs that are not absolutely required, together with
+ * their OFDs.  since finding them means walking all the DND trees, up
+ * to DND_EVICT_BATCH of them are freed at a time.
+ *
+ * for_md is TRUE when the block is for an MDBLOCK: we may then be in
+ * the middle of a user memory operation, so the directory indexes,
+ * which may live in user memory, are left alone.
+ *
+ * returns the number of blocks freed
  */
-WORD free_available_dnds(void)
+WORD free_available_dnds(BOOL for_md)
 {
+    DND *lru[DND_EVICT_BATCH];
     DMD *dmd;
-    WORD i;
+    WORD i, n, freed;
 
-    KDEBUG(("free_available_dnds() called\n"));
-    freed_dnds = freed_ofds = 0L;
+#if CONF_WITH_DIRINDEX
+    if (!for_md)
+        dirindex_drop(NULL, 0); /* directory indexes can always be rebuilt */
+#endif
 
     /*
-     * process all DMDs
+     * search all DMDs
      */
-    for (i = 0; i < BLKDEVNUM; i++) {
+    for (i = 0, n = 0; i < BLKDEVNUM; i++) {
         dmd = drvtbl[i];
-        if (!dmd)
-            continue;
-        if (dmd->m_dtl)
-            process_dnd_tree(dmd->m_dtl);
+        if (dmd && dmd->m_dtl)
+            lru_dnds(dmd->m_dtl, lru, &n);
+    }
+
+    if (!n) {
+        KDEBUG(("free_available_dnds(): no DND can be freed\n"));
+        return 0;
+    }
+
+    KDEBUG(("free_available_dnds(): freeing %d DNDs\n",n));
+    for (i = 0, freed = 0; i < n; i++) {
+        freed += lru[i]->d_ofd ? 2 : 1;
+        freednd(lru[i]);
     }
+    BDOS_COUNT(dndevictions, n);
 
-    KDEBUG(("freed %ld DNDs, %ld OFDs\n",freed_dnds,freed_ofds));
-    return freed_dnds+freed_ofds;
+    return freed;
 }
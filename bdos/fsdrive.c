@@ -105,13 +105,16 @@ WORD ckdrv(int d, BOOL checkrem)
     }
     else if (checkrem && (mask & drvrem))   /* handle removable media */
     {
-        if (Mediach(d))
+        if (chkmedia(d))
         {
             errdrv = d;
             rwerr = E_CHNG;         /* signal media change */
             errcode = rwerr;
             longjmp(errbuf,1);
         }
+#if CONF_WITH_FAT_WRITEBACK
+        flush_fat(d);       /* media unchanged, write pending FAT updates */
+#endif
     }
 
     /*
@@ -206,6 +209,16 @@ WORD log_media(BPB *b, int drv)
     if (!(dm = getdmd(drv)))
         return ENSMEM;
 
+#if CONF_WITH_EXTENT_MAP
+    extmap_invalidate();        /* new DMD may reuse an old one's address */
+#endif
+#if CONF_WITH_DIRINDEX
+    dirindex_drop(dm, 0);       /* likewise */
+#endif
+#if CONF_WITH_PGMCACHE
+    pgmcache_drop(dm, 0);       /* likewise */
+#endif
+
     d = dm->m_dtl;              /*  root DND for drive          */
     dm->m_fsiz = fs;            /*  fat size                    */
     f = d->d_ofd;               /*  root dir file               */
@@ -15,6 +15,9 @@
 #include "fs.h"
 #include "gemerror.h"
 #include "bdosstub.h"
+#include "mem.h"
+#include "string.h"
+#include "biosext.h"
 
 /*
 **  cl2rec -
@@ -26,6 +29,495 @@ RECNO cl2rec(CLNO cl, DMD *dm)
 }
 
 
+#if CONF_WITH_EXTENT_MAP
+/*
+ * extent maps
+ *
+ * to avoid walking the FAT chain from the start of a file for every
+ * backward seek, we remember the cluster chain of a few recently-used
+ * files as a list of extents (runs of contiguous clusters).  a map
+ * covers the chain from the start of the file up to (but excluding)
+ * the cluster with index x_end; it is built as the chain is walked.
+ *
+ * a map is identified by the DFD (which is shared by all OFDs for the
+ * same file), the DMD and the starting cluster.  any change to an
+ * existing link in a FAT, and any change of media, discards all maps.
+ */
+#define NUM_EXTMAPS     4       /* number of files with maps */
+#define NUM_EXTENTS     62      /* max extents per map */
+
+typedef struct
+{
+    CLNO    e_idx;      /* index within file of first cluster */
+    CLNO    e_cl;       /* number of first cluster */
+} EXTENT;
+
+typedef struct
+{
+    DFD     *x_dfd;     /* file, or NULL if map is unused */
+    DMD     *x_dmd;
+    CLNO    x_strtcl;   /* starting cluster of file */
+    CLNO    x_end;      /* index of first cluster not in map */
+    UWORD   x_count;    /* number of extents in use */
+    ULONG   x_used;     /* for LRU replacement */
+    EXTENT  x_ext[NUM_EXTENTS];
+} EXTMAP;
+
+static EXTMAP extmap[NUM_EXTMAPS];
+static ULONG extmap_clock;
+
+
+/*
+ * extmap_invalidate - discard all extent maps
+ */
+void extmap_invalidate(void)
+{
+    EXTMAP *x;
+
+    for (x = extmap; x < extmap+NUM_EXTMAPS; x++)
+    {
+        x->x_dfd = NULL;
+        x->x_used = 0;
+    }
+}
+
+
+/*
+ * extmap_get - find the extent map for a file
+ *
+ * if there is none and 'create' is set, a new map is created, replacing
+ * the least recently used one
+ */
+static EXTMAP *extmap_get(OFD *p, BOOL create)
+{
+    DFD *dfd = p->o_dfd;
+    EXTMAP *x, *old = extmap;
+
+    for (x = extmap; x < extmap+NUM_EXTMAPS; x++)
+    {
+        if ((x->x_dfd == dfd) && (x->x_dmd == p->o_dmd) && (x->x_strtcl == dfd->o_strtcl))
+        {
+            x->x_used = ++extmap_clock;
+            return x;
+        }
+        if (x->x_used < old->x_used)
+            old = x;
+    }
+
+    if (!create || !p->o_dnode || !dfd->o_strtcl)
+        return NULL;
+
+    x = old;
+    x->x_dfd = dfd;
+    x->x_dmd = p->o_dmd;
+    x->x_strtcl = dfd->o_strtcl;
+    x->x_end = 1;
+    x->x_count = 1;
+    x->x_used = ++extmap_clock;
+    x->x_ext[0].e_idx = 0;
+    x->x_ext[0].e_cl = dfd->o_strtcl;
+
+    return x;
+}
+
+
+/*
+ * extmap_cluster - return the cluster with index 'idx' in a map
+ *
+ * 'idx' must be less than x_end
+ */
+static CLNO extmap_cluster(EXTMAP *x, CLNO idx)
+{
+    EXTENT *e;
+
+    for (e = &x->x_ext[x->x_count-1]; e->e_idx > idx; e--)
+        ;
+
+    return e->e_cl + (idx - e->e_idx);
+}
+
+
+/*
+ * extmap_append - add the cluster with index x_end to a map
+ *
+ * returns FALSE if the map is full
+ */
+static BOOL extmap_append(EXTMAP *x, CLNO cl)
+{
+    EXTENT *e = &x->x_ext[x->x_count-1];
+
+    if (cl != e->e_cl + (x->x_end - e->e_idx))  /* not contiguous */
+    {
+        if (x->x_count >= NUM_EXTENTS)
+            return FALSE;
+        e++;
+        e->e_idx = x->x_end;
+        e->e_cl = cl;
+        x->x_count++;
+    }
+    x->x_end++;
+
+    return TRUE;
+}
+
+
+/*
+ * extmap_next - return the cluster following cluster 'cl' of a file,
+ * if it is known from the file's extent map; otherwise return 0
+ */
+static CLNO extmap_next(OFD *p, CLNO cl)
+{
+    EXTMAP *x;
+    EXTENT *e, *last;
+    CLNO len;
+
+    x = extmap_get(p, FALSE);
+    if (!x)
+        return 0;
+
+    last = &x->x_ext[x->x_count-1];
+    for (e = x->x_ext; e <= last; e++)
+    {
+        len = ((e < last) ? e[1].e_idx : x->x_end) - e->e_idx;
+        if ((cl >= e->e_cl) && (cl < e->e_cl+len))
+        {
+            if (cl < e->e_cl+len-1)
+                return cl + 1;
+            return (e < last) ? e[1].e_cl : 0;
+        }
+    }
+
+    return 0;
+}
+#endif
+
+
+#if CONF_WITH_FREE_BITMAP
+/*
+ * free cluster bitmaps
+ *
+ * for each drive, we can keep a bitmap of free clusters; it is built
+ * from the FAT when first needed and then kept up to date by clfix().
+ * a set bit indicates a free cluster, and the bit for cluster 'cl' is
+ * at FMAP_BIT(cl) in word FMAP_WORD(cl).  the bitmap is only valid if
+ * m_fmhint is non-zero; this protects against a build interrupted by a
+ * disk error.
+ *
+ * the bitmaps are carved out of a pool of ST-RAM reserved at boot by
+ * fmap_init(), so that machines without alt-RAM get them too.  the pool
+ * is kept compact: when a bitmap is freed, the ones above it are moved
+ * down.  if the pool is full, the bitmap is allocated from alt-RAM, if
+ * any, and owned by nobody.  it is never taken from the ST-RAM user
+ * pool, since it is allocated in the middle of GEMDOS calls, and would
+ * fragment the TPA.  a bitmap is freed when its DMD is freed after a
+ * media change.
+ */
+#define FMAP_WORD(cl)   ((cl) >> 4)
+#define FMAP_BIT(cl)    (0x8000U >> ((cl) & 15))
+#define FMAP_VALID(dm)  ((dm)->m_fmhint != 0)
+#define FMAP_SIZE(dm)   ((FMAP_WORD((dm)->m_numcl+2L) + 1) * sizeof(UWORD))
+#define FMAP_INPOOL(p)  (((UBYTE *)(p) >= fmap_pool) && ((UBYTE *)(p) < fmap_pool+fmap_poolsize))
+
+static UBYTE *fmap_pool;        /* the pool reserved at boot */
+static LONG fmap_poolsize;
+static LONG fmap_poolused;      /* bytes at the start of the pool in use */
+
+/*
+ * fmap_init - reserve the pool for the bitmaps
+ *
+ * like bufl_init(), this must be called before memory is initialised
+ */
+void fmap_init(void)
+{
+    fmap_poolsize = CONF_FREE_BITMAP_STRAM_SIZE;
+    if (fmap_poolsize)
+        fmap_pool = balloc_stram(fmap_poolsize, FALSE);
+}
+
+/*
+ * fmap_alloc - allocate a bitmap, from the pool if there is room
+ */
+static UWORD *fmap_alloc(LONG size)
+{
+    UWORD *map;
+
+    if (fmap_poolused + size <= fmap_poolsize)
+    {
+        map = (UWORD *)(fmap_pool + fmap_poolused);
+        fmap_poolused += size;
+        return map;
+    }
+
+    map = xmxalloc(size, MX_TTRAM);
+    if (map)
+        set_owner(map, NULL);
+
+    return map;
+}
+
+/*
+ * fmap_update - update bitmap for a change in the status of cluster 'cl'
+ */
+static void fmap_update(DMD *dm, CLNO cl, BOOL free)
+{
+    UWORD *p = dm->m_fmap + FMAP_WORD(cl);
+    UWORD bit = FMAP_BIT(cl);
+
+    if (free)
+    {
+        if (!(*p & bit))
+        {
+            *p |= bit;
+            dm->m_nfree++;
+            if (cl < dm->m_fmhint)
+                dm->m_fmhint = cl;
+        }
+    }
+    else if (*p & bit)
+    {
+        *p &= ~bit;
+        dm->m_nfree--;
+    }
+}
+
+
+/*
+ * fmap_build - build the free cluster bitmap for a drive
+ *
+ * returns FALSE if there is no room for the bitmap
+ */
+static BOOL fmap_build(DMD *dm)
+{
+    UWORD *map;
+    UBYTE *buf;
+    LONG size;
+    CLNO clnum, free;
+    int recnum, offset;
+
+    size = FMAP_SIZE(dm);
+    map = dm->m_fmap;
+    if (!map)
+    {
+        map = fmap_alloc(size);
+        if (!map)
+            return FALSE;
+        dm->m_fmap = map;
+    }
+    bzero(map, size);
+
+    free = 0;
+    if (dm->m_16)
+    {
+        /* fast scan of FAT16, one record at a time */
+        for (clnum = 2; clnum < dm->m_numcl+2; )
+        {
+            recnum = (clnum * sizeof(CLNO)) >> dm->m_rblog;
+            offset = (clnum * sizeof(CLNO)) & dm->m_rbm;
+            buf = getrec(recnum, dm->m_fatofd, 0);
+            for ( ; (offset < dm->m_recsiz) && (clnum < (dm->m_numcl+2)); offset += sizeof(CLNO), clnum++)
+            {
+                if (*(CLNO *)(buf+offset) == 0)
+                {
+                    map[FMAP_WORD(clnum)] |= FMAP_BIT(clnum);
+                    free++;
+                }
+            }
+        }
+    }
+    else
+    {
+        for (clnum = 2; clnum < dm->m_numcl+2; clnum++)
+        {
+            if (!getrealcl(clnum,dm))
+            {
+                map[FMAP_WORD(clnum)] |= FMAP_BIT(clnum);
+                free++;
+            }
+        }
+    }
+
+    dm->m_nfree = free;
+    dm->m_fmhint = 2;           /* bitmap is now valid */
+
+    return TRUE;
+}
+
+
+/*
+ * fmap_find - return the first free cluster not below 'cl', or 0 if none
+ */
+static CLNO fmap_find(DMD *dm, CLNO cl)
+{
+    UWORD *p, w;
+    ULONG i, n;
+
+    n = FMAP_WORD(dm->m_numcl+2L) + 1;
+    i = FMAP_WORD(cl);
+    p = dm->m_fmap + i;
+
+    /* ignore clusters below 'cl' in the first word */
+    for (w = *p & (0xffffU >> (cl & 15)); !w; w = *++p)
+        if (++i >= n)
+            return 0;
+
+    for (cl = i << 4; !(w & 0x8000U); w <<= 1)
+        cl++;
+
+    return cl;
+}
+
+
+/*
+ * fmap_free - free the free cluster bitmap for a drive
+ */
+void fmap_free(DMD *dm)
+{
+    UBYTE *p = (UBYTE *)dm->m_fmap;
+    LONG size;
+    DMD *d;
+    int i;
+
+    if (!p)
+        return;
+    dm->m_fmap = NULL;
+
+    if (!FMAP_INPOOL(p))
+    {
+        xmfree(p);
+        return;
+    }
+
+    /* close the gap, and move the bitmaps above it down */
+    size = FMAP_SIZE(dm);
+    memmove(p, p+size, fmap_pool+fmap_poolused-(p+size));
+    fmap_poolused -= size;
+
+    for (i = 0; i < BLKDEVNUM; i++)
+    {
+        d = drvtbl[i];
+        if (d && d->m_fmap && FMAP_INPOOL(d->m_fmap) && ((UBYTE *)d->m_fmap > p))
+            d->m_fmap = (UWORD *)((UBYTE *)d->m_fmap - size);
+    }
+}
+#endif
+
+
+#if CONF_WITH_PREALLOC
+/*
+ * cluster preallocation
+ *
+ * when a file is extended, we reserve a run of contiguous free clusters
+ * for it, so that files which are written in several parts, or at the
+ * same time as other files, do not become fragmented.  the reservation
+ * only exists in memory: the reserved clusters are removed from the free
+ * cluster bitmap (and counted in m_nresv) until they are either used by
+ * nextcl(), or released by prealloc_release() when the file is closed.
+ */
+
+/*
+ * fmap_findrun - find a run of free clusters
+ *
+ * returns the start of the first run of at least 'n' free clusters at
+ * or after cluster 'cl' or, failing that, at or after m_fmhint.  if there
+ * is no such run, the longest run is returned.  the length of the run
+ * (limited to 'n') is returned in *count; it is zero if there are no
+ * free clusters.
+ */
+static CLNO fmap_findrun(DMD *dm, CLNO cl, CLNO n, CLNO *count)
+{
+    CLNO start, len, best = 0, bestlen = 0;
+    CLNO end = dm->m_numcl + 2;
+    int pass;
+
+    for (pass = 0; pass < 2; pass++, cl = dm->m_fmhint)
+    {
+        for (start = fmap_find(dm, cl); start; start = fmap_find(dm, start+len))
+        {
+            for (len = 1; (len < n) && (start+len < end); len++)
+                if (!(dm->m_fmap[FMAP_WORD(start+len)] & FMAP_BIT(start+len)))
+                    break;
+            if (len > bestlen)
+            {
+                best = start;
+                bestlen = len;
+                if (len >= n)
+                    goto done;
+            }
+        }
+    }
+
+done:
+    *count = bestlen;
+    return best;
+}
+
+
+/*
+ * prealloc - reserve clusters so that a file can grow to 'size' bytes
+ *
+ * xwrite() calls this for each write which extends the file, and
+ * xfcopy() for the whole copy, so the run is sized to the data about
+ * to be written.  a file only has one reservation at a time: if it
+ * already covers the new clusters, this does nothing.  otherwise its
+ * unused part is released and a run of the required length is
+ * reserved, searching from the file's current cluster, so that it
+ * usually follows the clusters already written.  unused clusters are
+ * released when the file is closed.
+ */
+void prealloc(OFD *p, LONG size)
+{
+    DMD *dm = p->o_dmd;
+    DFD *dfd = p->o_dfd;
+    LONG n;
+    CLNO cl, count, i;
+
+    if (!p->o_dnode)
+        return;
+
+    n = ((size + dm->m_clbm) >> dm->m_clblog)
+        - ((dfd->o_fileln + dm->m_clbm) >> dm->m_clblog);
+    if ((n <= 1) || (n <= dfd->o_rsvcnt))   /* nothing to gain */
+        return;
+
+    if (dfd->o_rsvcnt)
+        prealloc_release(p);
+
+    if (!FMAP_VALID(dm) && !fmap_build(dm))
+        return;
+    if (n > dm->m_nfree)
+        n = dm->m_nfree;
+
+    cl = fmap_findrun(dm, p->o_curcl ? p->o_curcl : dm->m_fmhint, n, &count);
+    if (count <= 1)
+        return;
+
+    for (i = 0; i < count; i++)
+        fmap_update(dm, cl+i, FALSE);
+    dm->m_nresv += count;
+    dfd->o_rsvcl = cl;
+    dfd->o_rsvcnt = count;
+
+    KDEBUG(("prealloc(): reserved clusters %u-%u\n",cl,cl+count-1));
+}
+
+
+/*
+ * prealloc_release - release the unused clusters reserved for a file
+ */
+void prealloc_release(OFD *p)
+{
+    DMD *dm = p->o_dmd;
+    DFD *dfd = p->o_dfd;
+    CLNO i;
+
+    for (i = 0; i < dfd->o_rsvcnt; i++)
+        fmap_update(dm, dfd->o_rsvcl+i, TRUE);
+    dm->m_nresv -= dfd->o_rsvcnt;
+    dfd->o_rsvcnt = 0;
+}
+#endif
+
+
 /*
 **  clfix -
 **      replace the contents of the fat entry indexed by 'cl' with the value
@@ -40,6 +532,26 @@ void clfix(CLNO cl, CLNO link, DMD *dm)
     LONG offset, recnum;
     UBYTE *buf;
 
+#if CONF_WITH_EXTENT_MAP
+    /*
+     * extent maps only record links between clusters, so allocating a
+     * free cluster or extending a chain does not affect them
+     */
+    if (link == FREECLUSTER)
+        extmap_invalidate();
+    else
+    {
+        f = getrealcl(cl,dm);
+        if ((f >= 2) && !endofchain(f))
+            extmap_invalidate();
+    }
+#endif
+
+#if CONF_WITH_FREE_BITMAP
+    if (FMAP_VALID(dm))
+        fmap_update(dm, cl, link == FREECLUSTER);
+#endif
+
     offset = dm->m_16 ? (LONG)cl << 1 : ((LONG)cl + (cl >> 1));
     recnum = offset >> dm->m_rblog;
     offset &= dm->m_rbm;
@@ -166,6 +678,54 @@ CLNO getclnum(CLNO cl, OFD *of)
 }
 
 
+/*
+**  getclidx -
+**      get the number of the cluster with index 'idx' within a file,
+**      starting from cluster 'cl' with index 'curidx' (which must not
+**      be greater than 'idx').
+**
+**  returns
+**      the cluster number, or ENDOFCHAIN if the chain is too short
+*/
+CLNO getclidx(OFD *of, CLNO cl, CLNO curidx, CLNO idx)
+{
+#if CONF_WITH_EXTENT_MAP
+    EXTMAP *x;
+    CLNO n;
+    BOOL record = FALSE;
+
+    /*
+     * if we must start from the beginning of the file, that is the
+     * time to create an extent map
+     */
+    x = extmap_get(of, curidx == 0);
+    if (x)
+    {
+        n = (idx < x->x_end) ? idx : x->x_end-1;
+        if (n >= curidx)
+        {
+            cl = extmap_cluster(x, n);
+            curidx = n;
+            record = (n == x->x_end-1);
+        }
+    }
+#endif
+
+    for ( ; curidx < idx; curidx++)
+    {
+        cl = getclnum(cl,of);
+        if (endofchain(cl))
+            return ENDOFCHAIN;
+#if CONF_WITH_EXTENT_MAP
+        if (record)
+            record = extmap_append(x, cl);
+#endif
+    }
+
+    return cl;
+}
+
+
 /*
  * findfree16 - fast scan of FAT16 filesystem to find first free cluster
  *
@@ -209,6 +769,23 @@ static CLNO findfree(CLNO cl, DMD *dm)
 {
     CLNO i;
 
+#if CONF_WITH_FREE_BITMAP
+    if (FMAP_VALID(dm) || fmap_build(dm))
+    {
+        /*
+         * search from the current cluster, to keep the file contiguous,
+         * or else from the lowest cluster that may be free
+         */
+        if ((cl < dm->m_fmhint) || !(i = fmap_find(dm, cl)))
+        {
+            i = fmap_find(dm, dm->m_fmhint);
+            if (i)
+                dm->m_fmhint = i;
+        }
+        return i;
+    }
+#endif
+
     /*
      * fast scan for first free cluster on FAT16 filesystem
      */
@@ -263,11 +840,24 @@ int nextcl(OFD *p, int wrtflg)
     }
     else
     {
+#if CONF_WITH_EXTENT_MAP
+        cl2 = extmap_next(p, cl);
+        if (!cl2)
+#endif
         cl2 = getrealcl(cl,dm);
     }
 
     if (wrtflg && endofchain(cl2))  /* end of file, allocate new clusters */
     {
+#if CONF_WITH_PREALLOC
+        if (dfd->o_rsvcnt)      /* use reserved cluster if possible */
+        {
+            cl2 = dfd->o_rsvcl++;
+            dfd->o_rsvcnt--;
+            dm->m_nresv--;
+        }
+        else
+#endif
         cl2 = findfree(cl,dm);
         if (cl2 == 0)
             return -1;
@@ -346,6 +936,19 @@ long xgetfree(long *buf, int drv)
         return ERR;
 
     dm = drvtbl[n];
+#if CONF_WITH_FAT_WRITEBACK
+    flush_fat(n);               /* commit any pending FAT updates */
+#endif
+#if CONF_WITH_FREE_BITMAP
+    if (FMAP_VALID(dm) || fmap_build(dm))
+    {
+        free = dm->m_nfree;
+#if CONF_WITH_PREALLOC
+        free += dm->m_nresv;    /* reserved clusters are still free */
+#endif
+    }
+    else
+#endif
     if (dm->m_16)
     {
         free = countfree16(dm);
@@ -17,6 +17,7 @@
 #include "string.h"
 #include "tosvars.h"
 #include "intmath.h"
+#include "mem.h"
 
 
 #define CNTMAX  0x7FFFul  /* 16-bit MAXINT */
@@ -56,6 +57,13 @@ static void addit(OFD *p, long siz)
  */
 static void usrio(int rwflg, int num, long strt, char *ubuf, DMD *dm)
 {
+#if CONF_WITH_BDOS_CACHE
+    BDOS_COUNT(directrecs, num);
+    longjmp_rwabs(rwflg, (long)ubuf, num, strt+dm->m_recoff[BT_DATA], dm->m_drvnum);
+
+    /* any cached copies of the records remain valid */
+    bufl_direct(dm, rwflg, strt, num, (UBYTE *)ubuf);
+#else
     BCB *b;
 
     for (b = bufl[BI_DATA]; b; b = b->b_link)
@@ -70,7 +78,9 @@ static void usrio(int rwflg, int num, long strt, char *ubuf, DMD *dm)
         }
     }
 
+    BDOS_COUNT(directrecs, num);
     longjmp_rwabs(rwflg, (long)ubuf, num, strt+dm->m_recoff[BT_DATA], dm->m_drvnum);
+#endif
 }
 
 
@@ -187,6 +197,62 @@ static char *xrw_recs(WORD wrtflg, OFD *p, RECNO startrec, RECNO numrecs, char *
 }
 
 
+#if CONF_WITH_READAHEAD
+/*
+ * xrw_readahead - read ahead for a partial-record read
+ *
+ * called before reading part of record 'recn' (which must be in the
+ * current cluster) via getrec(); 'bytn' is the offset of the current
+ * position within the record.  if the file is being read sequentially,
+ * the following records of the current run of contiguous clusters are
+ * read into the cache as well.  the read-ahead window starts at 2
+ * records and doubles each time it is used.  nothing is done if 'recn'
+ * is already cached, so that partial-record reads which hit the cache
+ * don't pay for walking the FAT.
+ */
+static void xrw_readahead(OFD *p, RECNO recn, WORD bytn)
+{
+    DMD *dm = p->o_dmd;
+    CLNO cl, next;
+    LONG n, left;
+
+    if (!p->o_dnode)                    /* root directory isn't BT_DATA */
+        return;
+
+    if (!p->o_rawin)                    /* first read after open or seek */
+    {
+        p->o_rawin = 2;
+        return;
+    }
+
+    if (!readahead_wanted(dm, recn))    /* cache hit */
+        return;
+
+    /* limit the window to the end of the file ... */
+    n = p->o_rawin;
+    left = p->o_dfd->o_fileln - (p->o_bytnum - bytn);
+    left = (left + dm->m_rbm) >> dm->m_rblog;
+    if (n > left)
+        n = left;
+
+    /* ... and to the end of the run of contiguous clusters */
+    left = p->o_currec + dm->m_clsiz - recn;
+    for (cl = p->o_curcl; left < n; cl = next)
+    {
+        next = getrealcl(cl, dm);
+        if (next != cl + 1)
+            break;
+        left += dm->m_clsiz;
+    }
+    if (n > left)
+        n = left;
+
+    if (readahead(dm, recn, n) && (p->o_rawin < CONF_READAHEAD_SIZE / dm->m_recsiz))
+        p->o_rawin <<= 1;
+}
+#endif
+
+
 /*
  * xrw - read/write for BDOS functions
  *
@@ -232,6 +298,10 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
         /* #bytes left in current record ) */
 
         lenxfr = min(len,dm->m_recsiz-bytn);
+#if CONF_WITH_READAHEAD
+        if (!wrtflg)
+            xrw_readahead(p,recn,bytn);
+#endif
         bufp = getrec(recn,p,wrtflg);   /* get desired record  */
         addit(p,lenxfr);                /* update OFD          */
         len -= lenxfr;                  /* nbr left to do      */
@@ -269,6 +339,10 @@ static long xrw(int wrtflg, OFD *p, long len, char *ubufr)
             recn = 0;
         }
 
+#if CONF_WITH_READAHEAD
+        if (!wrtflg)
+            xrw_readahead(p,(RECNO)p->o_currec+recn,0);
+#endif
         bufp = getrec((RECNO)p->o_currec+recn,p,wrtflg);
         addit(p,lentail);
 
@@ -353,13 +427,18 @@ long xlseek(long n, int h, int flg)
 
 long ixlseek(OFD *p,long n)
 {
-    CLNO clnum, clx, curnum, i;
+    CLNO clnum, clx, curnum;
     DMD *dm = p->o_dmd;
     DFD *dfd = p->o_dfd;
 
     if ((n < 0) || (n > dfd->o_fileln))
         return ERANGE;
 
+#if CONF_WITH_READAHEAD
+    if (n != p->o_bytnum)
+        p->o_rawin = 0;                 /* no longer sequential */
+#endif
+
     if (n == 0)
     {
         p->o_curcl = p->o_currec = p->o_bytnum = p->o_curbyt = 0;
@@ -391,11 +470,13 @@ long ixlseek(OFD *p,long n)
         if (((p->o_curbyt == 0) || (p->o_curbyt == dm->m_clsizb)) && p->o_bytnum)
             curnum--;
 
-        clnum -= curnum;
         clx = p->o_curcl;
     }
     else            /* we have to start at the beginning */
+    {
+        curnum = 0;
         clx = dfd->o_strtcl;
+    }
 
     /*
      * note: if we're seeking to a position which is at a cluster boundary,
@@ -410,12 +491,9 @@ long ixlseek(OFD *p,long n)
     if ((n&dm->m_clbm) == 0)    /* go one less if on cluster boundary */
         clnum--;
 
-    for (i = 0; i < clnum; i++)
-    {
-        clx = getclnum(clx,p);
-        if (endofchain(clx))
-            return EINTRN;      /* FAT chain is shorter than filesize says ... */
-    }
+    clx = getclidx(p,clx,curnum,clnum);
+    if (endofchain(clx))
+        return EINTRN;          /* FAT chain is shorter than filesize says ... */
 
     p->o_curcl = clx;
     p->o_currec = cl2rec(clx,dm);
@@ -538,7 +616,13 @@ long xwrite(int h, long len, void *ubufr)
      */
 
     if (p)
+    {
+#if CONF_WITH_PREALLOC
+        if (p->o_bytnum+len > p->o_dfd->o_fileln)
+            prealloc(p, p->o_bytnum+len);   /* keep the file contiguous */
+#endif
         ret = ixwrite(p,len,ubufr);
+    }
     else
         ret = EIHNDL;
 
@@ -547,6 +631,113 @@ long xwrite(int h, long len, void *ubufr)
     return ret;
 }
 
+#if CONF_WITH_FCOPY
+/*
+ * xfcopy - copy up to 'len' bytes from handle 'hsrc' to handle 'hdst'
+ *
+ * Function 0x1C        Fcopy (EmuTOS extension)
+ *
+ * The data is copied from the current position of the source file to
+ * the current position of the destination file, and both positions are
+ * updated.  The copy stops at the end of the source file, or if the
+ * destination drive is full.  Since the final size of the destination
+ * is known, its clusters are reserved before copying, and the data is
+ * transferred in large blocks, so that whole records are read and
+ * written directly without going through the cache.
+ *
+ * The transfer buffer is owned by the system, not by the calling process
+ * (which may be the desktop, and never terminate).  If a disk error makes
+ * us longjmp out, it is freed by fcopy_cleanup().
+ *
+ * EINVFN is returned if either handle is not a file that we manage,
+ * i.e. it is a character device, or GEMDOS is hooked by another program
+ * which may own the handle.  ENSMEM is returned if there is not even
+ * memory for a small transfer buffer.  In both cases, nothing has been
+ * copied, and the caller should copy the data itself.  Any other error
+ * may occur after part of the data has been read from the source, so
+ * the caller must report it rather than carry on copying.
+ *
+ * returns the number of bytes copied, or
+ *   EINVFN
+ *   ENSMEM
+ *   bios()
+ */
+static char *fcopy_buf;         /* the transfer buffer, while copying */
+
+long xfcopy(int hsrc, int hdst, long len)
+{
+    OFD *src, *dst;
+    char *buf;
+    long bufsize, done, n, rc;
+
+    if (Setexc(0x21, -1L) != (LONG)enter)
+        return EINVFN;
+
+    src = getofd(hsrc);
+    dst = getofd(hdst);
+    if (!src || !dst)
+        return EINVFN;
+
+    n = src->o_dfd->o_fileln - src->o_bytnum;
+    if ((len < 0) || (len > n))
+        len = n;
+    if (len <= 0)
+        return 0L;
+
+    /* use ST-RAM if possible, so that DMA drivers need no bounce buffer */
+    bufsize = CONF_FCOPY_BUFSIZE;
+    while ((bufsize > 4096L) && (bufsize/2 >= len))
+        bufsize >>= 1;
+    while (!(buf = xmxalloc(bufsize, MX_PREFSTRAM)))
+    {
+        if (bufsize <= 4096L)
+            return ENSMEM;
+        bufsize >>= 1;
+    }
+    set_owner(buf, NULL);
+    fcopy_buf = buf;
+
+#if CONF_WITH_PREALLOC
+    prealloc(dst, dst->o_bytnum+len);
+#endif
+
+    for (done = 0L; done < len; done += n)
+    {
+        n = min(len-done, bufsize);
+        n = ixread(src, n, buf);
+        if (n <= 0)
+            break;
+        rc = ixwrite(dst, n, buf);
+        if (rc != n)            /* destination is full */
+        {
+            ixlseek(src, src->o_bytnum-(n-rc));
+            done += rc;
+            break;
+        }
+    }
+
+    fcopy_cleanup();
+
+    KDEBUG(("xfcopy(%d,%d): rc=%ld\n",hsrc,hdst,done));
+
+    return done;
+}
+
+/*
+ * fcopy_cleanup - free the transfer buffer of xfcopy()
+ *
+ * this is also called when a disk error has made us longjmp out of it
+ */
+void fcopy_cleanup(void)
+{
+    if (fcopy_buf)
+    {
+        xmfree(fcopy_buf);
+        fcopy_buf = NULL;
+    }
+}
+#endif
+
 /*
  *  ixwrite -
  */
@@ -195,6 +195,9 @@ long ixcreat(char *name, UBYTE attr)
     fcb->f_fileln = 0;
     ixlseek(fd,pos);
     ixwrite(fd,FNAMELEN,a);         /* write name, set dirty flag */
+#if CONF_WITH_DIRINDEX
+    dirindex_add(dn,pos,a);
+#endif
     ixclose(fd,CL_DIR);             /* partial close to flush */
     ixlseek(fd,pos);
     s = (char *)ixgetfcb(fd);
@@ -515,6 +518,11 @@ long ixclose(OFD *fd, int part)
     BCB *b;
     DFD *dfd = fd->o_dfd;
 
+#if CONF_WITH_PREALLOC
+    if (dfd->o_rsvcnt)              /* release unused reserved clusters */
+        prealloc_release(fd);
+#endif
+
     /*
      * if the file or folder has been modified, we need to make sure
      * that the date/time, starting cluster, and file length in the
@@ -547,6 +555,10 @@ long ixclose(OFD *fd, int part)
         ixlseek(fd->o_dirfil,fd->o_dirbyt+FNAMELEN);/* seek to attrib byte */
         ixwrite(fd->o_dirfil,1,&attr);          /*  & rewrite it       */
         dfd->o_flag &= ~O_DIRTY;            /* not dirty any more */
+#if CONF_WITH_PGMCACHE
+        if (dfd->o_strtcl)
+            pgmcache_drop(fd->o_dmd,dfd->o_strtcl); /* contents may have changed */
+#endif
     }
 
     if ((!part) || (part & CL_FULL))
@@ -573,6 +585,9 @@ long ixclose(OFD *fd, int part)
      * partitioned hard disks.  however this would cost code space and,
      * in practice, flushing usually takes place to one drive only.
      */
+#if CONF_WITH_FAT_WRITEBACK
+    flush_fat(-1);
+#endif
     for (i = BI_FAT; i <= BI_DATA; i++)
         for (b = bufl[i]; b; b = b->b_link)
             if ((b->b_bufdrv != -1) && b->b_dirty)
@@ -675,6 +690,15 @@ long ixdel(DND *dn, FCB *f, long pos)
     n = f->f_clust;
     swpw(n);
 
+#if CONF_WITH_DIRINDEX
+    if (f->f_attrib & FA_SUBDIR)
+        dirindex_drop(dm,n);
+#endif
+#if CONF_WITH_PGMCACHE
+    if (n)
+        pgmcache_drop(dm,n);        /* clusters may be reused */
+#endif
+
     while (n && !endofchain(n))
     {
         n2 = getrealcl(n,dm);
@@ -690,6 +714,9 @@ long ixdel(DND *dn, FCB *f, long pos)
     c = ERASE_MARKER;
     ixwrite(fd,1L,&c);
     ixclose(fd,CL_DIR);
+#if CONF_WITH_DIRINDEX
+    dirindex_free(dn,pos);
+#endif
 
     /*
      * NOTE that the preceding routines that do physical disk operations
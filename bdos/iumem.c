@@ -16,6 +16,7 @@
 #include "fs.h"
 #include "mem.h"
 #include "bdosstub.h"
+#include "tosvars.h"
 
 
 /*
@@ -29,13 +30,327 @@ long ccfreeit;
 #endif
 
 
+#if CONF_WITH_MALLOC_CLASSES
+/*
+ * size class index
+ *
+ * in addition to the (address-ordered) free list of each memory pool,
+ * the free MDs are kept on doubly-linked lists by size class, so that
+ * ffit() only needs to look at blocks that are big enough, and can
+ * choose the best fit among them.  class 0 holds blocks of less than
+ * 64 bytes, class n (n > 0) those of 2^(n+5) to 2^(n+6)-1 bytes, and
+ * the last class everything bigger.  the size of the largest free block
+ * is cached, so that Malloc(-1) does not need to search for it.
+ *
+ * the private fields of the MDs (see MDEXT) hold the links, so all MDs
+ * on the free list must have been allocated by xmgetmd().  code that
+ * changes the free list other than via ffit()/freeit() must call
+ * mpb_invalidate(), and the index is then rebuilt on next use.
+ */
+#define NUM_MCLASS  20
+
+typedef struct {
+    BOOL usable;            /* TRUE => all MDs have private fields */
+    BOOL valid;             /* FALSE => index must be rebuilt */
+    LONG maxfree;           /* size of largest free block, -1 if unknown */
+    MD *head[NUM_MCLASS];   /* first MD in each size class */
+} MPBINDEX;
+
+#if CONF_WITH_ALT_RAM
+static MPBINDEX mpbindex[2];
+#else
+static MPBINDEX mpbindex[1];
+#endif
+
+#define MDX(m)  ((MDEXT *)(m))
+
+static MPBINDEX *get_index(MPB *mp)
+{
+    MPBINDEX *x = NULL;
+
+    if (mp == &pmd)
+        x = &mpbindex[0];
+#if CONF_WITH_ALT_RAM
+    else if (mp == &pmdalt)
+        x = &mpbindex[1];
+#endif
+
+    return (x && x->usable) ? x : NULL;
+}
+
+static WORD size_class(LONG length)
+{
+    WORD n;
+
+    for (n = 0, length >>= 6; length && (n < NUM_MCLASS-1); n++)
+        length >>= 1;
+
+    return n;
+}
+
+static void class_add(MPBINDEX *x, MD *m)
+{
+    WORD n = size_class(m->m_length);
+
+    MDX(m)->m_cprev = NULL;
+    MDX(m)->m_cnext = x->head[n];
+    if (x->head[n])
+        MDX(x->head[n])->m_cprev = m;
+    x->head[n] = m;
+}
+
+/* must be called before the length of the MD is changed */
+static void class_remove(MPBINDEX *x, MD *m)
+{
+    MD *next = MDX(m)->m_cnext, *prev = MDX(m)->m_cprev;
+
+    if (next)
+        MDX(next)->m_cprev = prev;
+    if (prev)
+        MDX(prev)->m_cnext = next;
+    else
+        x->head[size_class(m->m_length)] = next;
+}
+
+/* set the back link of the free MD following 'prev' */
+static void set_prev(MD *prev)
+{
+    if (prev->m_link)
+        MDX(prev->m_link)->m_prev = prev;
+}
+
+static void rebuild_index(MPB *mp, MPBINDEX *x)
+{
+    MD *m, *prev;
+    WORD n;
+
+    for (n = 0; n < NUM_MCLASS; n++)
+        x->head[n] = NULL;
+    x->maxfree = 0L;
+
+    for (m = mp->mp_mfl, prev = NULL; m; prev = m, m = m->m_link)
+    {
+        MDX(m)->m_prev = prev;
+        class_add(x, m);
+        if (m->m_length > x->maxfree)
+            x->maxfree = m->m_length;
+    }
+
+    x->valid = TRUE;
+}
+
+/*
+ *  find_best - find the smallest free block of at least 'amount' bytes
+ */
+static MD *find_best(MPBINDEX *x, LONG amount)
+{
+    MD *m, *best;
+    WORD n;
+
+    for (n = size_class(amount); n < NUM_MCLASS; n++)
+    {
+        for (m = x->head[n], best = NULL; m; m = MDX(m)->m_cnext)
+        {
+            if (m->m_length < amount)
+                continue;
+            if (!best || (m->m_length < best->m_length))
+            {
+                best = m;
+                if (m->m_length == amount)
+                    break;
+            }
+        }
+        if (best)               /* all blocks in higher classes are bigger */
+            return best;
+    }
+
+    return NULL;
+}
+
+static LONG find_maxfree(MPBINDEX *x)
+{
+    MD *m;
+    LONG maxval = 0L;
+    WORD n;
+
+    for (n = NUM_MCLASS-1; n >= 0; n--)
+    {
+        for (m = x->head[n]; m; m = MDX(m)->m_cnext)
+            if (m->m_length > maxval)
+                maxval = m->m_length;
+        if (maxval)
+            break;
+    }
+
+    return maxval;
+}
+
+/*
+ *  mpb_init - set up the index for a memory pool
+ *
+ *  the BIOS supplies the initial MD, which is not part of an MDEXT, so
+ *  we replace it by a copy.  if that fails, the pool is not indexed.
+ */
+void mpb_init(MPB *mp)
+{
+    MPBINDEX *x;
+    MD *m, **prev;
+
+    if (mp == &pmd)
+        x = &mpbindex[0];
+#if CONF_WITH_ALT_RAM
+    else if (mp == &pmdalt)
+        x = &mpbindex[1];
+#endif
+    else
+        return;
+
+    for (prev = &mp->mp_mfl; (m = *prev); prev = &m->m_link)
+    {
+        if (m == &themd)
+        {
+            MD *copy = xmgetmd();
+            if (!copy)
+                return;
+            *copy = *m;
+            *prev = m = copy;
+        }
+    }
+
+    x->usable = TRUE;
+    x->valid = FALSE;
+}
+
+void mpb_invalidate(MPB *mp)
+{
+    MPBINDEX *x = get_index(mp);
+
+    if (x)
+        x->valid = FALSE;
+}
+#endif /* CONF_WITH_MALLOC_CLASSES */
+
+
+#if CONF_WITH_MALLOC_CLASSES
+/*
+ *  take_best - take 'amount' bytes from the best-fitting free block
+ */
+static MD *take_best(MPBINDEX *x, MPB *mp, LONG amount)
+{
+    MD *p, *q, *p1;
+
+    if ((x->maxfree >= 0L) && (amount > x->maxfree))
+        return NULL;
+
+    q = find_best(x, amount);
+    if (!q)
+        return NULL;
+
+    if (q->m_length == x->maxfree)
+        x->maxfree = -1L;       /* we don't know the new maximum */
+
+    if (q->m_length == amount)
+    {
+        /* take the whole thing */
+        class_remove(x, q);
+        p = MDX(q)->m_prev;
+        if (p)
+        {
+            p->m_link = q->m_link;
+            set_prev(p);
+        }
+        else
+        {
+            mp->mp_mfl = q->m_link;
+            if (q->m_link)
+                MDX(q->m_link)->m_prev = NULL;
+        }
+        return q;
+    }
+
+    /*
+     * break it up: get a new MD for the allocated memory, and leave the
+     * remainder on the free list, where it stays in address order
+     */
+    if ((p1=xmgetmd()) == NULL)
+    {
+        KDEBUG(("BDOS ffit: null MGET\n"));
+        return NULL;
+    }
+
+    class_remove(x, q);
+    p1->m_start = q->m_start;
+    p1->m_length = amount;
+    q->m_start += amount;
+    q->m_length -= amount;
+    class_add(x, q);
+
+    return p1;
+}
+#endif
+
+
+/*
+ *  take_first - take 'amount' bytes from the first free block that's
+ *  large enough
+ */
+static MD *take_first(MPB *mp, LONG amount)
+{
+    MD *p, *q, *p1;
+
+    /*
+     * look for first free space that's large enough
+     */
+    for (p = (MD *)mp, q = mp->mp_mfl; q; p = q, q = p->m_link)
+    {
+        if (q->m_length >= amount)
+            break;
+    }
+    if (!q)
+        return NULL;
+
+    if (q->m_length == amount)
+        p->m_link = q->m_link;  /* take the whole thing */
+    else
+    {
+        /* break it up - 1st allocate a new MD to describe the remainder */
+
+        /*********** TBD **********
+         * Nicer Handling of This *
+         *        Situation       *
+         **************************/
+        if ((p1=xmgetmd()) == NULL)
+        {
+            KDEBUG(("BDOS ffit: null MGET\n"));
+            return NULL;
+        }
+
+        /* init new MD for remaining memory on free chain */
+        p1->m_length = q->m_length - amount;
+        p1->m_start = q->m_start + amount;
+        p1->m_link = q->m_link;
+        p->m_link = p1;
+
+        /* adjust old MD for allocated memory on allocated chain */
+        q->m_length = amount;
+    }
+
+    return q;
+}
+
+
 /*
  *  ffit - find first fit for requested memory in ospool
+ *
+ *  with CONF_WITH_MALLOC_CLASSES, this finds the best fit instead
  */
 MD *ffit(long amount, MPB *mp)
 {
-    MD *p, *q, *p1;     /* free list is composed of MD's */
+    MD *q;
     LONG maxval;
+#if CONF_WITH_MALLOC_CLASSES
+    MPBINDEX *x;
+#endif
 
 #ifdef ENABLE_KDEBUG
     if (mp == &pmd)
@@ -53,19 +368,33 @@ MD *ffit(long amount, MPB *mp)
     ++ccffit;
 #endif
 
-    p = (MD *)mp;
     if ((q = mp->mp_mfl) == NULL)   /* get free list pointer */
     {
         KDEBUG(("BDOS ffit: null free list ptr\n"));
         return NULL;
     }
 
+#if CONF_WITH_MALLOC_CLASSES
+    x = get_index(mp);
+    if (x && !x->valid)
+        rebuild_index(mp, x);
+#endif
+
     /*
      * handle request for maximum free block
      */
     if (amount == -1L)
     {
-        for (maxval = 0L; q; p = q, q = p->m_link)
+#if CONF_WITH_MALLOC_CLASSES
+        if (x)
+        {
+            if (x->maxfree < 0L)
+                x->maxfree = find_maxfree(x);
+            KDEBUG(("BDOS ffit: maxval=%ld\n",x->maxfree));
+            return (MD *)x->maxfree;
+        }
+#endif
+        for (maxval = 0L; q; q = q->m_link)
             if (q->m_length > maxval)
                 maxval = q->m_length;
 
@@ -85,47 +414,18 @@ MD *ffit(long amount, MPB *mp)
     else
         amount = (amount + MALLOC_ALIGN_ALTRAM) & ~MALLOC_ALIGN_ALTRAM;
 
-    /*
-     * look for first free space that's large enough
-     * (this could be changed to a best-fit quite easily)
-     */
-    for ( ; q; p = q, q = p->m_link)
-    {
-        if (q->m_length >= amount)
-            break;
-    }
+#if CONF_WITH_MALLOC_CLASSES
+    if (x)
+        q = take_best(x, mp, amount);
+    else
+#endif
+        q = take_first(mp, amount);
     if (!q)
     {
         KDEBUG(("BDOS ffit: Not enough contiguous memory\n"));
         return NULL;
     }
 
-    if (q->m_length == amount)
-        p->m_link = q->m_link;  /* take the whole thing */
-    else
-    {
-        /* break it up - 1st allocate a new MD to describe the remainder */
-
-        /*********** TBD **********
-         * Nicer Handling of This *
-         *        Situation       *
-         **************************/
-        if ((p1=xmgetmd()) == NULL)
-        {
-            KDEBUG(("BDOS ffit: null MGET\n"));
-            return NULL;
-        }
-
-        /* init new MD for remaining memory on free chain */
-        p1->m_length = q->m_length - amount;
-        p1->m_start = q->m_start + amount;
-        p1->m_link = q->m_link;
-        p->m_link = p1;
-
-        /* adjust old MD for allocated memory on allocated chain */
-        q->m_length = amount;
-    }
-
     /*
      * link allocated block into allocated list & mark owner of block
      */
@@ -144,6 +444,12 @@ MD *ffit(long amount, MPB *mp)
 void freeit(MD *m, MPB *mp)
 {
     MD *p, *q, *f;
+#if CONF_WITH_MALLOC_CLASSES
+    MPBINDEX *x = get_index(mp);
+
+    if (x && !x->valid)         /* no need to maintain it */
+        x = NULL;
+#endif
 
 #ifdef ENABLE_KDEBUG
     if (mp == &pmd)
@@ -207,6 +513,10 @@ void freeit(MD *m, MPB *mp)
     if (f)
         if (p->m_start + p->m_length == f->m_start)
         { /* join to higher neighbor */
+#if CONF_WITH_MALLOC_CLASSES
+            if (x)
+                class_remove(x, f);
+#endif
             p->m_length += f->m_length;
             p->m_link = f->m_link;
             xmfremd(f);
@@ -215,10 +525,29 @@ void freeit(MD *m, MPB *mp)
     if (q)
         if (q->m_start + q->m_length == p->m_start)
         { /* join to lower neighbor */
+#if CONF_WITH_MALLOC_CLASSES
+            if (x)
+                class_remove(x, q);
+#endif
             q->m_length += p->m_length;
             q->m_link = p->m_link;
             xmfremd(p);
+            p = q;
         }
+
+#if CONF_WITH_MALLOC_CLASSES
+    /*
+     * update the index for the (possibly merged) free block
+     */
+    if (x)
+    {
+        MDX(p)->m_prev = (p == q) ? MDX(q)->m_prev : q;
+        set_prev(p);
+        class_add(x, p);
+        if ((x->maxfree >= 0L) && (p->m_length > x->maxfree))
+            x->maxfree = p->m_length;
+    }
+#endif
 }
 
 
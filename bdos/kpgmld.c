@@ -16,6 +16,7 @@
 
 #include "emutos.h"
 #include "fs.h"
+#include "mem.h"
 #include "proc.h"
 #include "gemerror.h"
 #include "pghdr.h"
@@ -27,7 +28,51 @@
  */
 
 static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd);
-static LONG pgfix01(UBYTE *lastcp, LONG nrelbytes, PGMINFO *pi);
+static LONG pgfix01(UBYTE **cpp, UBYTE *rp, LONG nrelbytes, PGMINFO *pi);
+
+
+/*
+ * if the symbol table is no bigger than this, pgmld01() reads it along
+ * with the rest of the file (rather than seeking past it), so that the
+ * whole program is loaded in one sequential read
+ */
+#define MAX_STREAMED_SYMBOLS    (16*1024L)
+
+
+#if CONF_WITH_PGMCACHE
+/*
+ *  program cache
+ *
+ *  the text, data and relocation info of recently loaded programs are
+ *  kept in alt-RAM, as read from the file.  an entry is identified by
+ *  the drive and starting cluster of the file, and is only used if the
+ *  date, time, length and program header still match.  entries are
+ *  also dropped when the file is modified or deleted, or when the media
+ *  changes.
+ */
+#define NUM_PGMCACHE    8
+
+typedef struct
+{
+    DMD     *pc_dmd;        /* drive, or NULL if entry is unused    */
+    CLNO    pc_strtcl;      /* starting cluster of file             */
+    DOSTIME pc_td;          /* date/time of file                    */
+    LONG    pc_fileln;      /* length of file                       */
+    PGMHDR01 pc_hdr;        /* program header                       */
+    LONG    pc_relst;       /* offset of 1st fixup, or 0            */
+    LONG    pc_rlen;        /* length of remaining relocation info  */
+    UBYTE   *pc_image;      /* text & data, then relocation info    */
+    ULONG   pc_lru;         /* for replacement                      */
+} PGMCACHE;
+
+static PGMCACHE pgmcache[NUM_PGMCACHE];
+static ULONG pgmcache_lru;
+static LONG pgmcache_size;  /* total size of the images */
+
+static PGMCACHE *pgmcache_find(OFD *fd, PGMHDR01 *hd);
+static void pgmcache_add(OFD *fd, PGMHDR01 *hd, UBYTE *text, LONG flen,
+                         LONG relst, UBYTE *rp, LONG rlen);
+#endif
 
 /*
  * kpgmhdrld - load program header
@@ -95,7 +140,10 @@ LONG kpgmld(PD *p, FH h, PGMHDR01 *hd)
  * handle 'h' using load file strategy like cp/m 68k.  Specifically:
  *
  * - read in program header and determine format parameters
- * - seek past the symbol table to the start of the relo info
+ * - if the rest of the file fits in the tpa and the symbol table is
+ *   small, read it all in one go (or copy it from the program cache)
+ *   and do the fixups from memory
+ * - otherwise seek past the symbol table to the start of the relo info
  * - read in the first offset (it's different than the rest in that
  *   it is a longword instead of a byte).
  * - make the first adjustment until we run out of relocation info or
@@ -109,9 +157,14 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
     PGMINFO *pi;
     PD      *p;
     PGMINFO pinfo;
-    UBYTE   *cp;
+    OFD     *fd;
+#if CONF_WITH_PGMCACHE
+    PGMCACHE *pc;
+#endif
+    UBYTE   *cp, *rp;
     LONG    relst;
     LONG    flen;
+    LONG    rest;
     LONG    r;
 
     pi = &pinfo;
@@ -144,6 +197,70 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
 
     memcpy(&p->p_tbase, &pi->pi_tbase, 6 * sizeof(long));
 
+    /*
+     * if possible, read the rest of the file (text, data, symbols and
+     * relocation info) in one go.  the relocation info then ends up
+     * beyond the bss base, where the fixups never write.
+     */
+    fd = getofd(h);
+    rest = fd ? fd->o_dfd->o_fileln - fd->o_bytnum : 0L;
+    rp = NULL;
+#if CONF_WITH_PGMCACHE
+    pc = fd ? pgmcache_find(fd, hd) : NULL;
+    if (pc)
+    {
+        /* a pristine copy is in the cache, no need to read the file */
+        memcpy(pi->pi_tbase, pc->pc_image, flen);
+        relst = pc->pc_relst;
+        rp = pc->pc_image + flen;
+        rest = pc->pc_rlen;
+
+        KDEBUG(("BDOS pgmld01: from cache, relst=0x%lx\n",relst));
+    }
+    else
+#endif
+    if (!hd->h01_abs && (pi->pi_slen <= MAX_STREAMED_SYMBOLS)
+     && (rest >= flen+pi->pi_slen+(LONG)sizeof(relst)) && (rest <= pi->pi_tpalen))
+    {
+        r = xread(h,rest,pi->pi_tbase);
+        if (r < 0)
+            return r;
+        if (r != rest)
+            return EPLFMT;
+
+        rp = pi->pi_bbase + pi->pi_slen;
+        memcpy(&relst, rp, sizeof(relst));  /* may be at an odd address */
+        rp += sizeof(relst);
+        rest -= rp - pi->pi_tbase;          /* size of relocation info */
+
+        KDEBUG(("BDOS pgmld01: streamed, relst=0x%lx\n",relst));
+
+#if CONF_WITH_PGMCACHE
+        pgmcache_add(fd, hd, pi->pi_tbase, flen, relst, rp, rest);
+#endif
+    }
+
+    if (rp)
+    {
+        if (relst != 0)
+        {
+            cp = pi->pi_tbase + relst;
+
+            /*  make sure we didn't wrap memory or overrun the bss  */
+
+            if ((cp < pi->pi_tbase) || (cp >= pi->pi_bbase) || (relst & 1))
+                return EPLFMT;
+
+            *((long *)(cp)) += (long)pi->pi_tbase ; /*  1st fixup     */
+
+            r = pgfix01(&cp, rp, rest, pi);
+            if (r < 0)
+                return r;
+        }
+
+        goto clear_bss;
+    }
+
     /*
      * read in the program file (text and data)
      */
@@ -181,7 +298,7 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
 
             /*  make sure we didn't wrap memory or overrun the bss  */
 
-            if ((cp < pi->pi_tbase) || (cp >= pi->pi_bbase))
+            if ((cp < pi->pi_tbase) || (cp >= pi->pi_bbase) || (relst & 1))
                 return EPLFMT;
 
             *((long *)(cp)) += (long)pi->pi_tbase ; /*  1st fixup     */
@@ -196,7 +313,7 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
                     break;
 
                 /*  do fixups using that info  */
-                r = pgfix01(cp, r, pi);
+                r = pgfix01(&cp, pi->pi_bbase, r, pi);
                 if (r <= 0)
                     break;
             }
@@ -209,6 +326,7 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
 
     /* clear the bss or the whole heap */
 
+clear_bss:
     if (hd->h01_flags & PF_FASTLOAD)
     {
         flen =  pi->pi_blen;                            /* clear only the bss */
@@ -228,53 +346,219 @@ static LONG pgmld01(FH h, PD *pdptr, PGMHDR01 *hd)
  * pgfix01 - do the next set of fixups
  *
  *  returns:
- *      addr of last modified longword in code segment (cp)
- *      0 if error or done
- *      stat01:
- *              >0: all offsets in bss used up, read in more
- *              =0: offset of 0 encountered, no more fixups
- *              <0: EPLFMT (load file format error)
+ *      >0: all offsets used up, read in more
+ *      =0: offset of 0 encountered, no more fixups
+ *      <0: EPLFMT (load file format error)
  *
  * Arguments:
+ *  cpp       - ptr to addr of last modified longword in code segment,
+ *              updated so that the fixups can continue with more info
+ *  rp        - relocation info pointer
  *  nrelbytes - number of avail rel values
  *  pi        - program info pointer
+ *
+ * since the address of the first fixup is even and 0xfe is even too,
+ * checking each offset for oddness is the same as checking cp.
+ *
+ * most offsets are ordinary ones (even, non-zero), so the info is read
+ * a longword at a time when possible: if its 4 bytes are all ordinary
+ * offsets, the 4 fixups are done without looking at each byte, and the
+ * bss limit only needs checking for the last one (the highest).
  */
+#define RELOC_LOWBITS   0x01010101UL
+#define RELOC_HIGHBITS  0x80808080UL
 
-static LONG pgfix01(UBYTE *lastcp, LONG nrelbytes, PGMINFO *pi)
+static LONG pgfix01(UBYTE **cpp, UBYTE *rp, LONG nrelbytes, PGMINFO *pi)
 {
     UBYTE *cp;              /*  code pointer                */
-    UBYTE *rp;              /*  relocation info pointer     */
-    LONG  n;                /*  nbr of relocation bytes     */
+    UBYTE *endrp;           /*  end of relocation info      */
     UBYTE *bbase;           /*  base addr of bss segment    */
     LONG  tbase;            /*  base addr of text segment   */
+    UBYTE b;
 
-    cp = lastcp;
-    rp = pi->pi_bbase;
-    n = nrelbytes;
+    cp = *cpp;
+    endrp = rp + nrelbytes;
     tbase = (LONG)pi->pi_tbase;
     bbase = pi->pi_bbase;
 
-    while(n-- && (*rp != 0))
+    while (rp < endrp)
     {
-        if (*rp == 1)
-            cp += 0xfe;
-        else
+        if (!((LONG)rp & 1) && (endrp - rp >= 4))
         {
-            cp += *rp;  /* add the byte at rp to cp, don't sign ext */
+            ULONG w = *(ULONG *)rp;
 
-            if (cp >= bbase)
-                return EPLFMT;
-            if (((LONG)cp) & 1)
+            /* no odd byte, and no zero byte */
+            if (!(w & RELOC_LOWBITS) && !((w - RELOC_LOWBITS) & ~w & RELOC_HIGHBITS))
+            {
+                UBYTE *cp1 = cp + (UBYTE)(w >> 24);
+                UBYTE *cp2 = cp1 + (UBYTE)(w >> 16);
+                UBYTE *cp3 = cp2 + (UBYTE)(w >> 8);
+
+                cp = cp3 + (UBYTE)w;
+                if (cp >= bbase)
+                    return EPLFMT;
+                *((long *)cp1) += tbase;
+                *((long *)cp2) += tbase;
+                *((long *)cp3) += tbase;
+                *((long *)cp) += tbase;
+                rp += 4;
+                continue;
+            }
+        }
+
+        b = *rp++;
+        if (b & 1)
+        {
+            if (b != 1)
                 return EPLFMT;
-            *((long *)cp) += tbase;
+            cp += 0xfe;
+            continue;
+        }
+        if (b == 0)
+        {
+            *cpp = cp;
+            return 0;
+        }
+        cp += b;    /* add the byte at rp to cp, don't sign ext */
+        if (cp >= bbase)
+            return EPLFMT;
+        *((long *)cp) += tbase;
+    }
+
+    *cpp = cp;
+    return 1;
+}
+
+
+#if CONF_WITH_PGMCACHE
+/*
+ * pgmcache_release - free a program cache entry
+ */
+static void pgmcache_release(PGMCACHE *pc)
+{
+    xmfree(pc->pc_image);
+    pgmcache_size -= pc->pc_hdr.h01_tlen + pc->pc_hdr.h01_dlen + pc->pc_rlen;
+    pc->pc_image = NULL;
+    pc->pc_dmd = NULL;
+}
+
+
+/*
+ * pgmcache_find - look for a cached copy of the program open on fd
+ */
+static PGMCACHE *pgmcache_find(OFD *fd, PGMHDR01 *hd)
+{
+    PGMCACHE *pc;
+    DFD *dfd = fd->o_dfd;
+
+    for (pc = pgmcache; pc < pgmcache+NUM_PGMCACHE; pc++)
+    {
+        if ((pc->pc_dmd != fd->o_dmd) || (pc->pc_strtcl != dfd->o_strtcl))
+            continue;
+        if ((pc->pc_td.time != dfd->o_td.time) || (pc->pc_td.date != dfd->o_td.date)
+         || (pc->pc_fileln != dfd->o_fileln)
+         || memcmp(&pc->pc_hdr, hd, sizeof(PGMHDR01)))
+        {
+            pgmcache_release(pc);   /* stale */
+            return NULL;
+        }
+        pc->pc_lru = ++pgmcache_lru;
+        return pc;
+    }
+
+    return NULL;
+}
+
+
+/*
+ * pgmcache_add - keep a copy of a program that has just been read,
+ * before it is relocated
+ */
+static void pgmcache_add(OFD *fd, PGMHDR01 *hd, UBYTE *text, LONG flen,
+                         LONG relst, UBYTE *rp, LONG rlen)
+{
+    PGMCACHE *pc, *p, *victim;
+    DFD *dfd = fd->o_dfd;
+    LONG size = flen + rlen;
+
+    /* big programs would only push everything else out */
+    if (!dfd->o_strtcl || (size > CONF_PGMCACHE_SIZE/4))
+        return;
+
+    /*
+     * free the least recently used entries until there is a free
+     * entry and the new image fits within the limit
+     */
+    for ( ; ; )
+    {
+        pc = victim = NULL;
+        for (p = pgmcache; p < pgmcache+NUM_PGMCACHE; p++)
+        {
+            if (!p->pc_dmd)
+                pc = p;
+            else if (!victim || (p->pc_lru < victim->pc_lru))
+                victim = p;
         }
-        ++rp;
+        if (pc && (pgmcache_size+size <= CONF_PGMCACHE_SIZE))
+            break;
+        pgmcache_release(victim);
     }
 
-    return (++n == 0) ? 1 : 0;
+    pc->pc_image = xmxalloc(size, MX_TTRAM);
+    if (!pc->pc_image)
+        return;
+    set_owner(pc->pc_image, NULL);  /* must survive the current process */
+    memcpy(pc->pc_image, text, flen);
+    memcpy(pc->pc_image+flen, rp, rlen);
+
+    pc->pc_dmd = fd->o_dmd;
+    pc->pc_strtcl = dfd->o_strtcl;
+    pc->pc_td = dfd->o_td;
+    pc->pc_fileln = dfd->o_fileln;
+    pc->pc_hdr = *hd;
+    pc->pc_relst = relst;
+    pc->pc_rlen = rlen;
+    pc->pc_lru = ++pgmcache_lru;
+    pgmcache_size += size;
+
+    KDEBUG(("pgmcache_add(): cached %ld bytes, %ld in total\n",size,pgmcache_size));
 }
 
 
+/*
+ * pgmcache_drop - drop the cached copy of the file starting at cluster cl
+ * on drive dm.  a cluster of 0 means all files on the drive, and a NULL
+ * drive means all drives.
+ */
+void pgmcache_drop(DMD *dm, CLNO cl)
+{
+    PGMCACHE *pc;
+
+    for (pc = pgmcache; pc < pgmcache+NUM_PGMCACHE; pc++)
+    {
+        if (!pc->pc_dmd)
+            continue;
+        if ((!dm || (pc->pc_dmd == dm)) && (!cl || (pc->pc_strtcl == cl)))
+            pgmcache_release(pc);
+    }
+}
+
+
+/*
+ * xpgmflush - Function 0x1E (Pflush) - EmuTOS extension
+ *
+ * empties the program cache, e.g. before replacing a program by one
+ * with the same date, time and length
+ */
+long xpgmflush(void)
+{
+    pgmcache_drop(NULL, 0);
+
+    return E_OK;
+}
+#endif
+
+
 #if DETECT_NATIVE_FEATURES
 LONG kpgm_relocate(PD *p, long length)
 {
@@ -346,7 +630,7 @@ LONG kpgm_relocate(PD *p, long length)
             memmove(pi->pi_bbase, rp, length);
 
             /* fixup with the reloc information available */
-            pgfix01(cp, length, pi);
+            pgfix01(&cp, pi->pi_bbase, length, pi);
         }
     }
 
@@ -50,6 +50,20 @@ void *xmgetblk(WORD memtype);
 /*  xmfreblk - free up memory allocated through mgetblk */
 void xmfreblk(void *m);
 
+/*
+ *  MDEXT - an MD as allocated by xmgetmd(), followed by private fields.
+ *  MDs are grouped in blocks of MDS_PER_BLOCK that must fit in 64 bytes.
+ */
+typedef struct {
+    MD md;
+    WORD index;         /* if used, 0 to MDS_PER_BLOCK-1, else -1 */
+#if CONF_WITH_MALLOC_CLASSES
+    MD *m_prev;         /* if free: previous MD on free list */
+    MD *m_cnext;        /* if free: next MD in the same size class */
+    MD *m_cprev;        /* if free: previous MD in the same size class */
+#endif
+} MDEXT;
+
 MD *xmgetmd(void);          /* xmgetmd - get an MD */
 void xmfremd(MD *md);       /* xmfremd - free an MD */
 
@@ -91,6 +105,12 @@ MD *ffit(long amount, MPB *mp);
 void freeit(MD *m, MPB *mp);
 /* shrink a memory descriptor */
 WORD shrinkit(MD *m, MPB *mp, LONG newlen);
+#if CONF_WITH_MALLOC_CLASSES
+/* set up the size class index for a memory pool */
+void mpb_init(MPB *mp);
+/* force rebuild of the index after changing the free list directly */
+void mpb_invalidate(MPB *mp);
+#endif
 
 
 #endif /* MEM_H */
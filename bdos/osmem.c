@@ -33,21 +33,30 @@
 /*
  *  local constants
  */
+#if CONF_WITH_MALLOC_CLASSES
+#define NUM_OSM_BLOCKS  158         /* MDBLOCKs hold fewer MDs, see below */
+#else
 #define NUM_OSM_BLOCKS  118         /* more than TOS, probably larger than necessary */
+#endif
 #define LEN_OSM_BLOCK   (2+64)      /* in bytes */
 /* size of os memory pool, in words: */
 #define LENOSM          (LEN_OSM_BLOCK*NUM_OSM_BLOCKS/sizeof(WORD))
 
+#if CONF_WITH_OSMEM_GROW
+#define OSM_GROW_BLOCKS 64          /* blocks added to the pool at a time */
+#define OSM_MAX_GROWN   (CONF_OSMEM_GROW_MAX/LEN_OSM_BLOCK)
+#define OSM_RESERVE     8           /* free blocks kept back for MDBLOCKs */
+#endif
+
 
 /*
  *  local typedefs
  */
+#if CONF_WITH_MALLOC_CLASSES
+#define MDS_PER_BLOCK   2           /* MDEXT is bigger */
+#else
 #define MDS_PER_BLOCK   3
-
-typedef struct {
-    MD md;
-    WORD index;         /* if used, 0-2, else -1 */
-} MDEXT;
+#endif
 
 typedef struct _mdb MDBLOCK;
 struct _mdb {
@@ -79,6 +88,11 @@ WORD *root[MAXQUICK];
 
 static MDBLOCK *mdbroot;    /* root for partially-used MDBLOCKs */
 
+#if CONF_WITH_OSMEM_GROW
+static WORD osmfree;        /* number of blocks on the free list */
+static LONG osmgrown;       /* number of blocks added by osmem_grow() */
+#endif
+
 
 /*
  *  local debug counters
@@ -115,6 +129,61 @@ static WORD *getosm(WORD n)
 }
 
 
+#if CONF_WITH_OSMEM_GROW
+/*
+ *  osmem_grow - add a chunk of blocks to the free list
+ *
+ *  The chunk is obtained from alt-RAM and belongs to the system, so it
+ *  is never freed.  ST-RAM is not used: a chunk taken from it would stay
+ *  as a permanent hole in the TPA.  Note that this must
+ *  not be called when allocating an MDBLOCK: xmxalloc() itself may need
+ *  an MD.
+ *
+ *  returns FALSE iff no more memory could be added
+ */
+static BOOL osmem_grow(void)
+{
+    WORD *m;
+    WORD i, n;
+
+    if (osmgrown >= OSM_MAX_GROWN)
+        return FALSE;
+    n = OSM_GROW_BLOCKS;
+    if (n > OSM_MAX_GROWN - osmgrown)
+        n = OSM_MAX_GROWN - osmgrown;
+
+    m = xmxalloc((LONG)n*LEN_OSM_BLOCK, MX_TTRAM);
+    if (!m)
+        return FALSE;
+    set_owner(m, NULL);         /* must survive the current process */
+    osmgrown += n;
+
+    for (i = 0; i < n; i++, m += LEN_OSM_BLOCK/sizeof(WORD))
+    {
+        *m = 4;                 /* control word, as set by xmgetblk() */
+        xmfreblk(m+1);
+    }
+    KDEBUG(("osmem_grow(): added %d blocks, %ld in total\n",n,osmgrown));
+
+    return TRUE;
+}
+
+
+/*
+ *  osmem_reserve - make sure that the pool is not running low
+ *
+ *  returns FALSE iff the pool is low and could not be grown
+ */
+static BOOL osmem_reserve(void)
+{
+    if (osmfree + osmlen/(LEN_OSM_BLOCK/sizeof(WORD)) >= OSM_RESERVE)
+        return TRUE;
+
+    return osmem_grow();
+}
+#endif
+
+
 /*
  *  unlink_mdblock - unlinks an MDBLOCK from the mdb chain
  *
@@ -154,8 +223,8 @@ static WORD unlink_mdblock(MDBLOCK *mdb)
  *  xmgetmd - get an MD
  *
  *  To create a single pool for all osmem requests, MDs are grouped in
- *  blocks of 3 called MDBLOCKs which occupy 58 bytes.  MDBLOCKs are
- *  handled as follows:
+ *  blocks of 3 (or 2 with CONF_WITH_MALLOC_CLASSES) called MDBLOCKs
+ *  which occupy 58 (or 64) bytes.  MDBLOCKs are handled as follows:
  *    . they are linked in a chain, initially empty
  *    . when the first MD is required, an MDBLOCK is obtained via
  *      xmgetblk() and put on the chain, and the first slot is allocated
@@ -249,26 +318,23 @@ void xmfremd(MD *md)
         if (mdb->entry[i].index < 0)
             avail++;
 
-    switch(avail) {
-    case 3:             /* remove from mdb chain & put on free chain */
+    if (avail == MDS_PER_BLOCK)     /* remove from mdb chain & put on free chain */
+    {
         KDEBUG(("xmfremd(): MDBLOCK at %p is now empty\n",mdb));
         if (unlink_mdblock(mdb) == 0)
         {
             xmfreblk(mdb);          /* move to free chain */
             KDEBUG(("xmfremd(): MDBLOCK at %p moved to free chain\n",mdb));
         }
-        break;
-    case 2:
-        break;
-    case 1:             /* add to mdb chain */
+    }
+    else if (avail == 1)            /* add to mdb chain */
+    {
         mdb->mdb_next = mdbroot;
         mdbroot = mdb;
         KDEBUG(("xmfremd(): MDBLOCK at %p now has free entry, moved to mdb chain\n",mdb));
-        break;
-    default:
-        KDEBUG(("xmfremd(): MDBLOCK at %p is invalid, %d free entries\n",mdb,avail));
-        break;
     }
+    else if (avail <= 0)
+        KDEBUG(("xmfremd(): MDBLOCK at %p is invalid, %d free entries\n",mdb,avail));
 }
 
 
@@ -281,6 +347,10 @@ void xmfremd(MD *md)
  * are no free blocks on the list, we call getosm to get a block from
  * the os memory pool.
  *
+ * With CONF_WITH_OSMEM_GROW, the free list is topped up from the user
+ * memory pools before a DMD/DND/OFD is allocated, leaving a few blocks
+ * for the MDBLOCKs needed to do that.
+ *
  * If we cannot get memory for an MDBLOCK, we return NULL (the request
  * will fail).  Otherwise we will attempt to free up DNDs to make space
  * and if that fails, the system will be halted.
@@ -304,6 +374,11 @@ void *xmgetblk(WORD memtype)
     i = 4;                          /* always from root[4] */
     w = 32;                         /* number of words */
 
+#if CONF_WITH_OSMEM_GROW
+    if (memtype != MEMTYPE_MDBLOCK)
+        osmem_reserve();
+#endif
+
     /*
      * we should execute the following loop a maximum of twice: the second
      * time only if we're allocating a DMD/DND/OFD & no memory is available
@@ -314,6 +389,10 @@ void *xmgetblk(WORD memtype)
         {
             m = *r;                 /* get first item on list   */
             *r = *((WORD **) m);    /* root points to next item */
+#if CONF_WITH_OSMEM_GROW
+            if (osmfree > 0)        /* FOLDRnnn.PRG may add blocks too */
+                osmfree--;
+#endif
             break;
         }
 
@@ -324,22 +403,23 @@ void *xmgetblk(WORD memtype)
             break;
         }
 
-        /* no memory available for an MDBLOCK, that's (sort of) OK */
-        if (memtype == MEMTYPE_MDBLOCK)
-            break;
-
         /*
-         * no memory for DMD/DND/OFD, try to get some
+         * no memory available, try to get some by freeing a cached DND
          *
          * note defensive programming: if free_available_dnds() said it
          * worked, but we're here again, then it lied and we should quit
          * to avoid an infinite loop
          */
-        if ((j >= 2) || (free_available_dnds() == 0))
-        {
-            kcprintf(_("\033EOut of internal memory.\nUse FOLDR100.PRG to get more.\nSystem halted!\n"));
-            halt();                         /*  halt system                  */
-        }
+        if ((j < 2) && (free_available_dnds(memtype == MEMTYPE_MDBLOCK) != 0))
+            continue;
+
+        /* no memory available for an MDBLOCK, that's (sort of) OK */
+        if (memtype == MEMTYPE_MDBLOCK)
+            break;
+
+        /* but it's fatal for a DMD/DND/OFD */
+        kcprintf(_("\033EOut of internal memory.\nUse FOLDR100.PRG to get more.\nSystem halted!\n"));
+        halt();                             /*  halt system                  */
     }
 
     /*
@@ -378,6 +458,9 @@ void xmfreblk(void *m)
         /*  ok to free up  */
         *((WORD **) m) = root[i];
         root[i] = m;
+#if CONF_WITH_OSMEM_GROW
+        osmfree++;
+#endif
         if (*((WORD **)m) == m)
             KDEBUG(("xmfreblk: Circular link in root[0x%x] at 0x%p\n",i,m));
     }
@@ -391,6 +474,10 @@ void osmem_init(void)
 {
     osmlen = LENOSM;
     mdbroot = NULL;
+#if CONF_WITH_OSMEM_GROW
+    osmfree = 0;
+    osmgrown = 0;
+#endif
     dbgfreblk = 0;
     dbggtosm = 0;
     dbggtblk = 0;
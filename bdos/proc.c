@@ -574,6 +574,14 @@ static void proc_go(PD *p)
     /* the new process is the one to run */
     run = (PD *)p;
 
+#if BLKDEV_HOLDS_WRITES
+    /* Pexec() does not return through osif(), so write the disk writes
+     * held back during it now: the program may run for a long time.
+     * any error has already been through the critical error handler.
+     */
+    blkdev_release();
+#endif
+
     gouser();
 }
 
@@ -614,6 +622,10 @@ void xterm(UWORD rc)
      * sep 2005 RCL
      */
     run->p_dreg[0] = rc;
+#if BLKDEV_HOLDS_WRITES
+    /* nor does this call, so write what ixterm() held back */
+    blkdev_release();
+#endif
     termuser();
 }
 
@@ -35,6 +35,10 @@ WORD xtermres(long blkln, WORD rc);
 LONG kpgmhdrld(FH h, PGMHDR01 *hd);
 LONG kpgmld(PD *p, FH h, PGMHDR01 *hd);
 
+#if CONF_WITH_PGMCACHE
+long xpgmflush(void);
+#endif
+
 #if DETECT_NATIVE_FEATURES
 LONG kpgm_relocate( PD *p, long length); /* SOP */
 #endif
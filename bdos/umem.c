@@ -413,6 +413,9 @@ void *srealloc(long amount)
 
     /* update length in MD, plus saved video ram info */
     last->m_length = last->m_length + video_ram_size - amount;
+#if CONF_WITH_MALLOC_CLASSES
+    mpb_invalidate(&pmd);
+#endif
     video_ram_size = amount;
     video_ram_addr = last->m_start + last->m_length;
 
@@ -473,11 +476,17 @@ long xmaddalt(UBYTE *start, LONG size)
         if (p->m_start + p->m_length == start) {
             /* new block is just after a free one, extend it at end */
             p->m_length += size;
+#if CONF_WITH_MALLOC_CLASSES
+            mpb_invalidate(&pmdalt);
+#endif
             return 0;
         } else if (start + size == p->m_start) {
             /* new block is just before a free one, extend it at beginning */
             p->m_start -= size;
             p->m_length += size;
+#if CONF_WITH_MALLOC_CLASSES
+            mpb_invalidate(&pmdalt);
+#endif
             return 0;
         }
     }
@@ -512,6 +521,9 @@ long xmaddalt(UBYTE *start, LONG size)
         pmdalt.mp_mal = NULL;
         has_alt_ram = 1;
     }
+#if CONF_WITH_MALLOC_CLASSES
+    mpb_init(&pmdalt);
+#endif
 
     return 0;
 }
@@ -558,6 +570,9 @@ void umem_init(void)
     start_stram = pmd.mp_mfl->m_start;
     end_stram = start_stram + pmd.mp_mfl->m_length;
     KDEBUG(("umem_init(): start_stram=%p, end_stram=%p\n",start_stram,end_stram));
+#if CONF_WITH_MALLOC_CLASSES
+    mpb_init(&pmd);
+#endif
 
 #if CONF_WITH_ALT_RAM
     /* there is no known alternative RAM initially */
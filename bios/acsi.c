@@ -41,7 +41,7 @@ static void acsi_begin(void);
 static void acsi_end(void);
 static void hdc_start_dma(UWORD control);
 static void dma_send_byte(UBYTE data, UWORD control);
-static int do_acsi_rw(WORD rw, LONG sect, WORD cnt, UBYTE *buf, WORD dev);
+static LONG do_acsi_rw(UWORD rw, ULONG sect, UWORD cnt, UBYTE *buf, WORD dev);
 static LONG acsi_capacity(WORD dev, ULONG *info);
 static LONG acsi_testunit(WORD dev);
 static LONG acsi_inquiry(WORD dev, UBYTE *buf);
@@ -127,7 +127,7 @@ LONG acsi_rw(WORD rw, LONG sector, WORD count, UBYTE *buf, WORD dev)
     WORD maxsecs_per_io = MAXSECS_PER_ACSI_IO;
     BOOL use_tmpbuf = FALSE;
     int retry;
-    int err = 0;
+    LONG err = 0;
     UBYTE *p, *tmp_buf = NULL;
 
     rw &= RW_RW;    /* we just care about read or write for now */
@@ -135,9 +135,13 @@ LONG acsi_rw(WORD rw, LONG sector, WORD count, UBYTE *buf, WORD dev)
     /*
      * the ACSI hardware requires that the buffer be word-aligned and
      * located in ST-RAM.  if it isn't, we use an intermediate buffer:
-     * the FRB (if available) or dskbufp.
+     * the bounce pool, the FRB (if available) or dskbufp.
      */
     if (IS_ODD_POINTER(buf) || !IS_STRAM_POINTER(buf)) {
+#if CONF_WITH_DMA_BOUNCE
+        if (dmabounce)
+            return dma_bounce_rw(rw, sector, count, buf, dev, MAXSECS_PER_ACSI_IO, do_acsi_rw);
+#endif
 #if CONF_WITH_FRB
         tmp_buf = get_frb_cookie();
         if (maxsecs_per_io > FRB_SECS)
@@ -167,7 +171,7 @@ LONG acsi_rw(WORD rw, LONG sector, WORD count, UBYTE *buf, WORD dev)
         }
 
         if (err) {
-            KDEBUG(("acsi.c: %s error %d\n",rw?"write":"read",err));
+            KDEBUG(("acsi.c: %s error %ld\n",rw?"write":"read",err));
             KDEBUG(("        dev=%d,sector=%ld,numsecs=%d\n",dev,sector,numsecs));
             return err;
         }
@@ -377,7 +381,7 @@ static void acsi_end(void)
  * cnt <= 0xFF, no retry done, returns -1 if timeout, or the DMA status.
  */
 
-static int do_acsi_rw(WORD rw, LONG sector, WORD cnt, UBYTE *buf, WORD dev)
+static LONG do_acsi_rw(UWORD rw, ULONG sector, UWORD cnt, UBYTE *buf, WORD dev)
 {
     ACSICMD cmd;
     UBYTE cdb[10];  /* allow for 10-byte read/write commands */
@@ -524,6 +528,9 @@ int send_command(WORD dev,ACSICMD *cmd)
 
         /* send the last byte & wait for completion of DMA */
         dma_send_byte(*p,control&0xff00);
+#if CONF_WITH_DMA_BOUNCE
+        dma_overlap_copy();     /* meanwhile, copy the other bounce half */
+#endif
         status = timeout_gpip(cmd->timeout);
         next_acsi_time = hz_200 + INTER_IO_TIME;    /* next safe time */
         if (status)
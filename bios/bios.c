@@ -42,6 +42,7 @@
 #include "mfp.h"
 #include "floppy.h"
 #include "sound.h"
+#include "dma.h"
 #include "dmasound.h"
 #include "dsp.h"
 #include "screen.h"
@@ -50,6 +51,8 @@
 #include "asm.h"
 #include "chardev.h"
 #include "blkdev.h"
+#include "disk.h"
+#include "ramdisk.h"
 #include "parport.h"
 #include "serport.h"
 #include "string.h"
@@ -519,6 +522,22 @@ static void bios_init(void)
     KDEBUG(("osinit_after_xmaddalt()\n"));
     osinit_after_xmaddalt();    /* initialize BDOS (part 2) */
     KDEBUG(("after osinit_after_xmaddalt()\n"));
+
+#if CONF_WITH_BLKDEV_CACHE
+    blkdev_cache_init();        /* needs GEMDOS memory management */
+#endif
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+    flop_trkbuf_init();         /* likewise */
+#endif
+#if CONF_WITH_RAMDISK
+    ramdisk_init();             /* likewise */
+#endif
+#if CONF_WITH_DMA_BOUNCE
+    dma_bounce_init();          /* likewise */
+#endif
+#if CONF_WITH_DISK_MERGE
+    disk_merge_init();          /* likewise */
+#endif
     boot_status |= DOS_AVAILABLE;   /* track progress */
 
     /* Enable VBL processing */
@@ -834,6 +853,10 @@ void biosmain(void)
         Pexec(PE_GO, "", (char *)pd, default_env);
     }
 
+#if BLKDEV_HOLDS_WRITES
+    blkdev_release();           /* write anything still held back */
+#endif
+
 #if CONF_WITH_SHUTDOWN
     /* try to shutdown the machine / close the emulator */
     shutdown();
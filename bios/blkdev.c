@@ -34,6 +34,9 @@
 #include "biosmem.h"
 #include "xhdi.h"
 #include "intmath.h"
+#include "vectors.h"
+#include "has.h"
+#include "../bdos/bdosstub.h"
 
 
 /*
@@ -202,6 +205,41 @@ static void blkdev_hdv_init(void)
     pun_info_setup();
 }
 
+#if CONF_WITH_RAMDISK
+/*
+ * blkdev_add_unit - register a unit which only becomes available after
+ * blkdev_hdv_init(), i.e. the RAM disk, and add its partitions to XHDI
+ * and PUN_INFO
+ */
+void blkdev_add_unit(UWORD unit)
+{
+    LONG drivemap;
+    int i, n;
+
+    disk_init_late(unit);
+    drivemap = units[unit].drivemap;
+    if (!drivemap)
+        return;
+
+#if CONF_WITH_XHDI
+    init_XHDI_drvmap();
+#endif
+
+    pun_info.puns++;
+    for (i = n = NUMFLOPPIES; i < BLKDEVNUM; i++)
+    {
+        if (!(drivemap & (1L << i)))
+            continue;
+        while ((n < PUN_MAXUNITS) && (pun_info.pun[n] != 0xff))
+            n++;
+        if (n >= PUN_MAXUNITS)      /* cannot store info for devices > P: */
+            break;
+        pun_info.pun[n] = unit - NUMFLOPPIES;
+        pun_info.partition_start[n] = blkdev[i].start;
+    }
+}
+#endif /* CONF_WITH_RAMDISK */
+
 /*
  * call bus initialisation routines
  */
@@ -401,6 +439,635 @@ int add_partition(UWORD unit, LONG *devices_available, char id[], ULONG start, U
 }
 
 
+/*
+ * unit_rw - read/write physical sectors of a unit
+ */
+static LONG unit_rw(WORD rw, UBYTE *buf, WORD cnt, LONG sector, WORD unit)
+{
+    GEOMETRY *geo = &blkdev[unit].geometry;
+    LONG ret;
+
+    ret = (unit<NUMFLOPPIES) ? floppy_rw(rw, buf, cnt, sector, geo->spt, geo->sides, unit)
+                             : disk_rw(unit, (rw & ~RW_NOTRANSLATE), sector, cnt, buf);
+
+    /*
+     * only real accesses count for the media change heuristics, not
+     * cache hits (floppy.c records them itself, also for the floppies)
+     */
+    if ((ret == 0) && (unit >= NUMFLOPPIES))
+        units[unit].last_access = hz_200;
+
+    return ret;
+}
+
+
+#if CONF_WITH_BLKDEV_CACHE
+
+/*
+ * unit-level block cache
+ *
+ * the cache holds copies of recently used physical sectors of the units
+ * other than floppies whose sectors are SECTOR_SIZE bytes long.  it sits
+ * below the logical to physical translation in blkdev_rwabs(), so logical
+ * requests and physical (RW_NOTRANSLATE) ones share the same copies.  the
+ * blocks are kept in an LRU list, and indexed by a hash table on unit &
+ * sector number.
+ *
+ * with write-behind, sectors written to non-removable units during a
+ * GEMDOS call (between blkdev_hold() and blkdev_release()) are only
+ * copied to the cache and marked dirty.  blkdev_release() writes the
+ * dirty sectors at the end of the call, or before GEMDOS starts or
+ * resumes a program, in ascending sector order (a single sweep of the
+ * heads), combining runs of consecutive sectors into one request.  these writes get the same retries and critical
+ * error handling as blkdev_rwabs(); sectors which still cannot be
+ * written are dropped, and the error is returned to GEMDOS.  removable
+ * units are always written through, so that a media change can never
+ * cause data to be written to the wrong medium.
+ *
+ * the cache is emptied for a unit when a media change is detected or
+ * forced, and when a new BPB is read for a removable unit.  transfers
+ * which bypass blkdev_rwabs() (XHDI, DMAread()/DMAwrite(), Flopwr(),
+ * Flopfmt()) call blkdev_cache_sync() first.
+ */
+
+#define BC_SHIFT        9       /* log2(SECTOR_SIZE) */
+#define BC_RUNMAX       16      /* max sectors per write when flushing */
+#define BC_FLUSH_DELAY  (2*CLOCKS_PER_SEC)  /* max age of dirty sectors */
+
+typedef struct _bcblock BCBLOCK;
+struct _bcblock
+{
+    BCBLOCK     *hnext;         /* next block in hash chain */
+    BCBLOCK     *newer;         /* LRU list links */
+    BCBLOCK     *older;
+    LONG        sector;         /* physical sector number */
+    WORD        unit;           /* -1 if the block is unused */
+    UBYTE       dirty;          /* not written yet (write-behind only) */
+    UBYTE       *data;
+};
+
+static BCBLOCK *bc_block;       /* the cache blocks */
+static BCBLOCK **bc_hash;       /* hash index */
+static BCBLOCK *bc_newest, *bc_oldest;
+static UWORD bc_count;          /* number of blocks, 0 if no cache */
+static UWORD bc_hashmask;
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+static BOOL bc_hold;            /* TRUE during a GEMDOS call */
+static UWORD bc_ndirty;         /* number of dirty blocks */
+static LONG bc_error;           /* first error from writing dirty blocks */
+static LONG bc_deadline;        /* when the dirty blocks must be written */
+static BCBLOCK **bc_sorted;     /* work array for bc_flush() */
+static UBYTE *bc_runbuf;        /* for writing runs of sectors */
+#endif
+
+#define BC_HASH(unit,sector)    (((UWORD)(sector) ^ ((UWORD)(unit) << 7)) & bc_hashmask)
+
+/* transfers bigger than this are not copied to the cache */
+#define BC_TOOBIG(cnt)          ((cnt) > bc_count/4)
+
+/*
+ * blkdev_cache_init - allocate the cache
+ *
+ * this is called once GEMDOS knows about any Alt-RAM
+ */
+void blkdev_cache_init(void)
+{
+    BCBLOCK *b;
+    UBYTE *p;
+    LONG size = CONF_BLKDEV_CACHE_SIZE;
+    WORD mode = MX_STRAM;
+    UWORD i, n, nhash;
+
+#if CONF_WITH_ALT_RAM
+    if (has_alt_ram)
+        mode = MX_TTRAM;
+    else
+#endif
+        size /= 4;
+
+    n = size / (SECTOR_SIZE + sizeof(BCBLOCK));
+    if (n == 0)
+        return;
+    for (nhash = 16; nhash < n/2; nhash <<= 1)
+        ;
+
+    size = n * (SECTOR_SIZE + sizeof(BCBLOCK)) + nhash * sizeof(BCBLOCK *);
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+    size += BC_RUNMAX * SECTOR_SIZE + n * sizeof(BCBLOCK *);
+#endif
+    p = xmxalloc(size, mode);
+    if (!p)
+        return;
+    bzero(p, size);
+
+    /* sector buffers first, to keep them aligned */
+    bc_block = (BCBLOCK *)(p + n * SECTOR_SIZE);
+    for (i = 0, b = bc_block; i < n; i++, b++, p += SECTOR_SIZE)
+    {
+        b->data = p;
+        b->unit = -1;
+        b->newer = (i > 0) ? b - 1 : NULL;
+        b->older = (i < n-1) ? b + 1 : NULL;
+    }
+    bc_newest = bc_block;
+    bc_oldest = b - 1;
+    bc_hash = (BCBLOCK **)b;
+    bc_hashmask = nhash - 1;
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+    bc_sorted = bc_hash + nhash;
+    bc_runbuf = (UBYTE *)(bc_sorted + n);
+#endif
+    bc_count = n;
+
+    KDEBUG(("blkdev_cache_init(): %u blocks, %u hash entries\n", n, nhash));
+}
+
+static void bc_unlink(BCBLOCK *b)
+{
+    if (b->newer)
+        b->newer->older = b->older;
+    else
+        bc_newest = b->older;
+    if (b->older)
+        b->older->newer = b->newer;
+    else
+        bc_oldest = b->newer;
+}
+
+static void bc_make_newest(BCBLOCK *b)
+{
+    if (b == bc_newest)
+        return;
+    bc_unlink(b);
+    b->newer = NULL;
+    b->older = bc_newest;
+    bc_newest->newer = b;
+    bc_newest = b;
+}
+
+static void bc_make_oldest(BCBLOCK *b)
+{
+    if (b == bc_oldest)
+        return;
+    bc_unlink(b);
+    b->older = NULL;
+    b->newer = bc_oldest;
+    bc_oldest->older = b;
+    bc_oldest = b;
+}
+
+static BCBLOCK *bc_lookup(WORD unit, LONG sector)
+{
+    BCBLOCK *b;
+
+    for (b = bc_hash[BC_HASH(unit,sector)]; b; b = b->hnext)
+        if ((b->sector == sector) && (b->unit == unit))
+            return b;
+
+    return NULL;
+}
+
+static void bc_unhash(BCBLOCK *b)
+{
+    BCBLOCK **pp;
+
+    for (pp = &bc_hash[BC_HASH(b->unit,b->sector)]; *pp != b; pp = &(*pp)->hnext)
+        ;
+    *pp = b->hnext;
+}
+
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+static void bc_clean(BCBLOCK *b)
+{
+    if (b->dirty)
+    {
+        b->dirty = FALSE;
+        bc_ndirty--;
+    }
+}
+#else
+#define bc_clean(b)
+#endif
+
+/* forget a block; it will be the first one to be reused */
+static void bc_free(BCBLOCK *b)
+{
+    bc_unhash(b);
+    bc_clean(b);
+    b->unit = -1;
+    bc_make_oldest(b);
+}
+
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+/* TRUE if a must be written before b */
+static BOOL bc_before(const BCBLOCK *a, const BCBLOCK *b)
+{
+    if (a->unit != b->unit)
+        return a->unit < b->unit;
+
+    return a->sector < b->sector;
+}
+
+/*
+ * bc_flush - write the dirty blocks of a unit (of all units if negative)
+ *
+ * sectors which cannot be written are dropped, like the data of a
+ * failed write, and the first error is kept for blkdev_release().
+ */
+static void bc_flush(WORD unit)
+{
+    BCBLOCK *b, **sorted = bc_sorted;
+    UBYTE *buf;
+    UWORD i, j, k, n;
+    LONG ret;
+    int retries;
+
+    /* collect the dirty blocks, sorted by unit & sector */
+    for (i = 0, n = 0, b = bc_block; i < bc_count; i++, b++)
+    {
+        if (!b->dirty || ((unit >= 0) && (b->unit != unit)))
+            continue;
+        for (j = n++; (j > 0) && bc_before(b, sorted[j-1]); j--)
+            sorted[j] = sorted[j-1];
+        sorted[j] = b;
+    }
+
+    for (i = 0; i < n; i = j)
+    {
+        b = sorted[i];
+        for (j = i + 1; (j < n) && (j - i < BC_RUNMAX); j++)
+            if ((sorted[j]->unit != b->unit) || (sorted[j]->sector != b->sector + (j - i)))
+                break;
+
+        if (j - i == 1)
+            buf = b->data;
+        else
+        {
+            for (k = i, buf = bc_runbuf; k < j; k++, buf += SECTOR_SIZE)
+                memcpy(buf, sorted[k]->data, SECTOR_SIZE);
+            buf = bc_runbuf;
+        }
+
+        do {
+            retries = RWABS_RETRIES;
+            do {
+                ret = unit_rw(RW_WRITE, buf, j - i, b->sector, b->unit);
+            } while ((ret < 0) && (ret != E_CHNG) && (--retries > 0));
+            if (ret < 0)
+                ret = blkdev_critic(ret, b->unit);
+        } while (ret == CRITIC_RETRY_REQUEST);
+        if ((ret < 0) && !bc_error)
+            bc_error = ret;
+        for (k = i; k < j; k++)
+        {
+            if (ret < 0)
+                bc_free(sorted[k]);
+            else
+                bc_clean(sorted[k]);
+        }
+        if (ret < 0)
+            KDEBUG(("bc_flush(): unit %d, sector %ld: error %ld\n", b->unit, b->sector, ret));
+    }
+
+    if (bc_ndirty)      /* dirty blocks of other units remain */
+        bc_deadline = hz_200 + BC_FLUSH_DELAY;
+}
+
+#endif
+
+/*
+ * bc_invalidate - forget the cached sectors of a unit (of all units if
+ * negative), after writing any dirty ones
+ */
+static void bc_invalidate(WORD unit)
+{
+    BCBLOCK *b;
+    UWORD i;
+
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+    if (bc_ndirty)
+        bc_flush(unit);
+#endif
+
+    for (i = 0, b = bc_block; i < bc_count; i++, b++)
+        if ((b->unit >= 0) && ((unit < 0) || (b->unit == unit)))
+            bc_free(b);
+}
+
+/*
+ * blkdev_cache_sync - prepare a unit for a transfer which bypasses the
+ * cache
+ *
+ * the dirty sectors of the unit are written first; for a write, all the
+ * cached sectors of the unit are forgotten, since they may become stale.
+ */
+void blkdev_cache_sync(WORD unit, WORD rw)
+{
+    if ((unit < 0) || (unit >= UNITSNUM) || !bc_count)
+        return;
+
+    if (rw & RW_WRITE)
+        bc_invalidate(unit);
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+    else if (bc_ndirty)
+        bc_flush(unit);
+#endif
+}
+
+/*
+ * bc_alloc - get a block for a sector which is not in the cache
+ *
+ * this returns NULL if no clean block is available
+ */
+static BCBLOCK *bc_alloc(WORD unit, LONG sector)
+{
+    BCBLOCK *b, **pp;
+
+    for (b = bc_oldest; b && b->dirty; b = b->newer)
+        ;
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+    if (!b)
+    {
+        bc_flush(-1);
+        for (b = bc_oldest; b && b->dirty; b = b->newer)
+            ;
+    }
+#endif
+    if (!b)
+        return NULL;
+
+    if (b->unit >= 0)
+        bc_unhash(b);
+    b->unit = unit;
+    b->sector = sector;
+    pp = &bc_hash[BC_HASH(unit,sector)];
+    b->hnext = *pp;
+    *pp = b;
+    bc_make_newest(b);
+
+    return b;
+}
+
+/*
+ * bc_update - keep the cache coherent after a write-through
+ *
+ * if the write succeeded, the sectors are copied to the cache; if not,
+ * any cached copies are forgotten.
+ */
+static void bc_update(WORD unit, LONG sector, WORD cnt, const UBYTE *buf, BOOL ok)
+{
+    BCBLOCK *b;
+    UWORD i;
+
+    if (BC_TOOBIG(cnt))
+    {
+        /* just update existing copies; this is faster than lookups */
+        for (i = 0, b = bc_block; i < bc_count; i++, b++)
+        {
+            if ((b->unit != unit) || (b->sector < sector) || (b->sector >= sector + cnt))
+                continue;
+            if (!ok)
+                bc_free(b);
+            else
+            {
+                memcpy(b->data, buf + ((b->sector - sector) << BC_SHIFT), SECTOR_SIZE);
+                bc_clean(b);
+            }
+        }
+        return;
+    }
+
+    for (i = 0; i < cnt; i++, sector++, buf += SECTOR_SIZE)
+    {
+        b = bc_lookup(unit, sector);
+        if (!ok)
+        {
+            if (b)
+                bc_free(b);
+            continue;
+        }
+        if (!b)
+            b = bc_alloc(unit, sector);
+        if (!b)
+            continue;
+        memcpy(b->data, buf, SECTOR_SIZE);
+        bc_clean(b);
+        bc_make_newest(b);
+    }
+}
+
+static LONG bc_read(WORD rw, UBYTE *buf, WORD cnt, LONG sector, WORD unit)
+{
+    BCBLOCK *b;
+    LONG ret;
+    WORD i, n;
+
+    while (cnt > 0)
+    {
+        b = bc_lookup(unit, sector);
+        if (b)
+        {
+            memcpy(buf, b->data, SECTOR_SIZE);
+            bc_make_newest(b);
+            n = 1;
+        }
+        else
+        {
+            /* read the whole run of missing sectors in one request */
+            for (n = 1; (n < cnt) && !bc_lookup(unit, sector + n); n++)
+                ;
+            ret = unit_rw(rw, buf, n, sector, unit);
+            if (ret < 0)
+                return ret;
+            for (i = 0; i < n; i++)
+            {
+                b = BC_TOOBIG(n) ? NULL : bc_alloc(unit, sector + i);
+                if (!b)
+                    break;
+                memcpy(b->data, buf + ((LONG)i << BC_SHIFT), SECTOR_SIZE);
+            }
+        }
+        buf += (LONG)n << BC_SHIFT;
+        sector += n;
+        cnt -= n;
+    }
+
+    return 0;
+}
+
+static LONG bc_write(WORD rw, UBYTE *buf, WORD cnt, LONG sector, WORD unit)
+{
+    LONG ret;
+
+#if CONF_BLKDEV_CACHE_WRITEBEHIND
+    if (bc_hold && !(units[unit].features & UNIT_REMOVABLE) && !BC_TOOBIG(cnt))
+    {
+        BCBLOCK *b;
+
+        for ( ; cnt > 0; cnt--, sector++, buf += SECTOR_SIZE)
+        {
+            b = bc_lookup(unit, sector);
+            if (!b)
+                b = bc_alloc(unit, sector);
+            if (!b)
+                break;      /* write the rest through */
+            memcpy(b->data, buf, SECTOR_SIZE);
+            bc_make_newest(b);
+            if (!b->dirty)
+            {
+                b->dirty = TRUE;
+                if (!bc_ndirty++)
+                    bc_deadline = hz_200 + BC_FLUSH_DELAY;
+            }
+        }
+        if (cnt == 0)
+            return 0;
+    }
+#endif
+
+    ret = unit_rw(rw, buf, cnt, sector, unit);
+    bc_update(unit, sector, cnt, buf, ret >= 0);
+
+    return ret;
+}
+
+/*
+ * blkdev_cache_drop - forget the cached copies of sectors of a unit,
+ * after a held back write of them has failed
+ */
+void blkdev_cache_drop(WORD unit, LONG sector, WORD cnt)
+{
+    BCBLOCK *b;
+
+    if (!bc_count)
+        return;
+
+    for ( ; cnt > 0; cnt--, sector++)
+    {
+        b = bc_lookup(unit, sector);
+        if (b && !b->dirty)     /* a dirty copy is newer, so keep it */
+            bc_free(b);
+    }
+}
+
+/*
+ * bc_rw - read/write physical sectors of a unit via the cache
+ */
+static LONG bc_rw(WORD rw, UBYTE *buf, WORD cnt, LONG sector, WORD unit)
+{
+    if (!bc_count || (units[unit].psshift != BC_SHIFT))
+        return unit_rw(rw, buf, cnt, sector, unit);
+
+    /*
+     * a floppy can be swapped without anything calling Mediach(), so a
+     * raw reader could be given the old disk's sectors.  floppies have
+     * their own short-lived track buffer instead (see floppy.c).
+     */
+    if (unit < NUMFLOPPIES)
+        return unit_rw(rw, buf, cnt, sector, unit);
+
+#if CONF_WITH_RAMDISK
+    /* caching the RAM disk would only waste memory */
+    if (unit == RAMDISK_UNIT)
+        return unit_rw(rw, buf, cnt, sector, unit);
+#endif
+
+    /* RW_NOBYTESWAP requests see different data, so bypass the cache */
+    if (rw & RW_NOBYTESWAP)
+    {
+        blkdev_cache_sync(unit, rw);
+        return unit_rw(rw, buf, cnt, sector, unit);
+    }
+
+    if (rw & RW_WRITE)
+        return bc_write(rw, buf, cnt, sector, unit);
+
+    return bc_read(rw, buf, cnt, sector, unit);
+}
+
+#endif /* CONF_WITH_BLKDEV_CACHE */
+
+
+/*
+ * blkdev_critic - call the critical error handler for an error on a unit
+ *
+ * this is for writes that were held back, so the error is reported for
+ * the first logical drive on the unit.  returns the error if there is
+ * none.
+ */
+LONG blkdev_critic(LONG error, WORD unit)
+{
+    WORD dev;
+
+    if (unit < NUMFLOPPIES)
+        return call_etv_critic((WORD)error, unit);
+
+    for (dev = 0; dev < BLKDEVNUM; dev++)
+        if (units[unit].drivemap & (1L << dev))
+            return call_etv_critic((WORD)error, dev);
+
+    return error;
+}
+
+
+#if BLKDEV_HOLDS_WRITES
+/*
+ * blkdev_hold - start holding back disk writes, at the start of a
+ * GEMDOS call
+ */
+void blkdev_hold(void)
+{
+#if CONF_WITH_BLKDEV_CACHE && CONF_BLKDEV_CACHE_WRITEBEHIND
+    bc_hold = (bc_count != 0);
+#endif
+#if CONF_WITH_DISK_MERGE
+    disk_merge_begin();
+#endif
+#if CONF_WITH_SDMMC
+    sd_hold(TRUE);
+#endif
+}
+
+/*
+ * blkdev_release - write the disk writes held back, at the end of a
+ * GEMDOS call, before GEMDOS starts or resumes a program, and before
+ * shutdown, and end any SD/MMC transfer session
+ *
+ * returns the first error from writing them since blkdev_hold(), or 0
+ */
+LONG blkdev_release(void)
+{
+    LONG ret = 0L;
+
+#if CONF_WITH_BLKDEV_CACHE && CONF_BLKDEV_CACHE_WRITEBEHIND
+    bc_hold = FALSE;
+    if (bc_ndirty)
+        bc_flush(-1);
+    ret = bc_error;
+    bc_error = 0L;
+#endif
+#if CONF_WITH_DISK_MERGE
+    {
+        /* after the cache, which may have written to the merge buffer */
+        LONG err = disk_merge_end();
+        if (!ret)
+            ret = err;
+    }
+#endif
+#if CONF_WITH_SDMMC
+    {
+        /* last, since the above may write to a card */
+        LONG err = sd_hold(FALSE);
+        if (!ret)
+            ret = err;
+    }
+#endif
+
+    return ret;
+}
+#endif /* BLKDEV_HOLDS_WRITES */
+
+
 /*
  * blkdev_rwabs - BIOS block device read/write vector
  */
@@ -415,7 +1082,6 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
     LONG retval;
     WORD psshift;
     UBYTE *bufstart = buf;
-    GEOMETRY *geo;
 
     KDEBUG(("rwabs(rw=%d, buf=%p, count=%ld, recnr=%u, dev=%d, lrecnr=%ld)\n",
             rw,buf,lcount,recnr,dev,lrecnr));
@@ -428,6 +1094,10 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
      */
     if ((dev < NUMFLOPPIES) && (buf == NULL)) {
         blkdev[dev].mediachange = cnt;
+#if CONF_WITH_BLKDEV_CACHE
+        if (cnt != MEDIANOCHANGE)
+            bc_invalidate(dev);
+#endif
         return 0L;
     }
 
@@ -509,15 +1179,22 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
     }
 
     psshift = units[unit].psshift;
-    geo = &blkdev[unit].geometry;
+
+#if CONF_WITH_BLKDEV_CACHE && CONF_BLKDEV_CACHE_WRITEBEHIND
+    if (bc_ndirty && (hz_200 - bc_deadline >= 0))
+        bc_flush(-1);
+#endif
 
     do {
         /* split the transfer to 15-bit count blocks (lowlevel functions take WORD count) */
         WORD scount = (lcount > CNTMAX) ? CNTMAX : lcount;
         do {        /* outer loop retries if critical event handler says we should */
             do {    /* inner loop automatically retries */
-                retval = (unit<NUMFLOPPIES) ? floppy_rw(rw, buf, scount, lrecnr, geo->spt, geo->sides, unit)
-                                            : disk_rw(unit, (rw & ~RW_NOTRANSLATE), lrecnr, scount, buf);
+#if CONF_WITH_BLKDEV_CACHE
+                retval = bc_rw(rw, buf, scount, lrecnr, unit);
+#else
+                retval = unit_rw(rw, buf, scount, lrecnr, unit);
+#endif
                 if (retval == E_CHNG)       /* no automatic retry on media change */
                     break;
             } while((retval < 0) && (--retries > 0));
@@ -535,12 +1212,13 @@ static LONG blkdev_rwabs(WORD rw, UBYTE *buf, WORD cnt, WORD recnr, WORD dev, LO
     if ((rw&RW_RW) == RW_READ)
         instruction_cache_kludge(bufstart,cnt<<psshift);
 
-    if (retval == 0)
-        units[unit].last_access = hz_200;
-
-    if (retval == E_CHNG)
+    if (retval == E_CHNG) {
+#if CONF_WITH_BLKDEV_CACHE
+        bc_invalidate(unit);
+#endif
         if (unit >= NUMFLOPPIES)
             disk_rescan(unit);
+    }
 
     return retval;
 }
@@ -592,6 +1270,11 @@ LONG blkdev_getbpb(WORD dev)
 
     bdev->mediachange = MEDIANOCHANGE;      /* reset now */
     bdev->forcechange = FALSE;
+#if CONF_WITH_BLKDEV_CACHE
+    /* a new BPB for a removable unit means the medium may be a new one */
+    if (units[unit].features & UNIT_REMOVABLE)
+        bc_invalidate(unit);
+#endif
     /*
      * set XHDI's "invalid BPB" indicator for non-floppy units
      * only, since they are the ones that might have a FAT32 or
@@ -818,11 +1501,110 @@ static LONG blkdev_mediach(WORD dev)
     if (ret != MEDIANOCHANGE) {
         units[unit].status |= UNIT_CHANGED;
         b->mediachange = ret;
+#if CONF_WITH_BLKDEV_CACHE
+        bc_invalidate(unit);
+#endif
     }
+#if CONF_WITH_MEDIACH_POLICY
+    else
+        b->mcchecked = hz_200;
+#endif
 
     return b->mediachange;
 }
 
+#if CONF_WITH_MEDIACH_POLICY
+/*
+ * blkdev_mcneeded - tell GEMDOS if it must call Mediach() for a device
+ *
+ * Media in non-removable units cannot change behind our back, and those
+ * in removable units are only checked again once CONF_MEDIACH_WINDOW
+ * ticks have passed since the last check.  Pending or forced media
+ * changes are always reported via Mediach(), and so is everything if
+ * someone else has hooked hdv_mediach or the BIOS trap.
+ */
+BOOL blkdev_mcneeded(WORD dev)
+{
+    BLKDEV *b = &blkdev[dev];
+
+    if ((dev < 0 ) || (dev >= BLKDEVNUM) || !(b->flags&DEVICE_VALID))
+        return TRUE;
+
+    if ((hdv_mediach != blkdev_mediach) || (VEC_BIOS != biostrap))
+        return TRUE;
+
+    if ((b->mediachange != MEDIANOCHANGE) || b->forcechange)
+        return TRUE;
+
+    if (units[b->unit].features & UNIT_REMOVABLE)
+        return (hz_200 - b->mcchecked) >= CONF_MEDIACH_WINDOW;
+
+    return FALSE;
+}
+
+/*
+ * blkdev_force_mediach - make the next Mediach() report a media change
+ * for all the devices of a unit
+ *
+ * This is used by XHMediumChanged().
+ */
+LONG blkdev_force_mediach(UWORD unit)
+{
+    LONG bitmask;
+    int i;
+
+    if ((unit >= UNITSNUM) || !units[unit].valid)
+        return EUNDEV;
+
+    if ((unit >= NUMFLOPPIES) && (units[unit].features & UNIT_REMOVABLE)) {
+        disk_rescan(unit);  /* partitions may have changed too */
+    } else {
+        for (i = 0, bitmask = 1L; i < BLKDEVNUM; i++, bitmask <<= 1)
+            if (units[unit].drivemap & bitmask)
+                blkdev[i].mediachange = MEDIACHANGE;
+    }
+    units[unit].status |= UNIT_CHANGED;
+#if CONF_WITH_BLKDEV_CACHE
+    bc_invalidate(unit);
+#endif
+
+    return E_OK;
+}
+#endif
+
+#if CONF_WITH_DMA_BOUNCE
+/*
+ * blkdev_mxalloc_mode - tell GEMDOS where its disk buffers belong
+ *
+ * Returns MX_STRAM if some hard disk transfers its data with a DMA chip
+ * which can only reach ST-RAM (ACSI, Falcon SCSI): buffers in Alt-RAM
+ * must then be copied via a bounce buffer.  Otherwise returns MX_TTRAM.
+ */
+WORD blkdev_mxalloc_mode(void)
+{
+    UWORD unit;
+
+    for (unit = NUMFLOPPIES; unit < UNITSNUM; unit++) {
+        if (!units[unit].valid || (units[unit].features & UNIT_NATFEATS))
+            continue;
+        switch(GET_BUS(unit-NUMFLOPPIES)) {
+#if CONF_WITH_ACSI
+        case ACSI_BUS:
+            return MX_STRAM;
+#endif
+#if CONF_WITH_SCSI
+        case SCSI_BUS:
+            if (scsi_needs_stram())
+                return MX_STRAM;
+            break;
+#endif
+        }
+    }
+
+    return MX_TTRAM;
+}
+#endif
+
 
 /**
  * blkdev_drvmap - Read drive bitmap
@@ -107,6 +107,17 @@ LONG blkdev_boot(void);
 LONG blkdev_getbpb(WORD dev);
 LONG blkdev_drvmap(void);
 LONG blkdev_avail(WORD dev);
+#if CONF_WITH_MEDIACH_POLICY
+LONG blkdev_force_mediach(UWORD unit);
+#endif
+#if CONF_WITH_RAMDISK
+void blkdev_add_unit(UWORD unit);
+#endif
+#if CONF_WITH_BLKDEV_CACHE
+void blkdev_cache_init(void);
+void blkdev_cache_sync(WORD unit, WORD rw);
+void blkdev_cache_drop(WORD unit, LONG sector, WORD cnt);
+#endif
 UWORD compute_cksum(const UWORD *buf);
 WORD get_shift(ULONG blocksize);
 
@@ -114,6 +125,7 @@ int add_partition(UWORD unit, LONG *devices_available, char id[], ULONG start, U
 
 /* critical error handling */
 LONG call_etv_critic(WORD error,WORD device);   /* in vectors.S */
+LONG blkdev_critic(LONG error, WORD unit);
 
 
 /*
@@ -161,6 +173,9 @@ struct _blkdev
     UBYTE       serial2[4];     /* serial number 2 (MSDOS) from the bootsector */
     int         unit;           /* 0,1 = floppies, 2-9 = ACSI, 10-17 = SCSI, */
                                 /*  18-25 = IDE, 26-33 = SD/MMC              */
+#if CONF_WITH_MEDIACH_POLICY
+    LONG        mcchecked;      /* hz_200 when media were last found unchanged */
+#endif
 };
 typedef struct _blkdev  BLKDEV;
 
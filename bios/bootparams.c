@@ -29,4 +29,10 @@ const ALTRAM_REGION altram_regions[MAX_ALTRAM_REGIONS] = { { NULL, 0 } };
 
 #endif /* MACHINE_AMIGA */
 
+#if CONF_WITH_RAMDISK
+
+const ULONG ramdisk_size = 0;
+
+#endif /* CONF_WITH_RAMDISK */
+
 #endif /* EMUTOS_LIVES_IN_RAM */
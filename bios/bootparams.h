@@ -33,4 +33,11 @@ extern const ALTRAM_REGION altram_regions[MAX_ALTRAM_REGIONS];
 
 #endif /* MACHINE_AMIGA */
 
+#if EMUTOS_LIVES_IN_RAM && CONF_WITH_RAMDISK
+
+/* Size of the RAM disk in bytes, if not zero. See ramdisk.c. */
+extern const ULONG ramdisk_size;
+
+#endif
+
 #endif /* IDE_H */
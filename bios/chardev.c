@@ -16,6 +16,7 @@
 #include "gemerror.h"
 #include "tosvars.h"
 #include "chardev.h"
+#include "biosext.h"
 #include "conout.h"
 #include "vt52.h"
 #include "bios.h"
@@ -24,6 +25,7 @@
 #include "ikbd.h"
 #include "midi.h"
 #include "parport.h"
+#include "vectors.h"
 
 #define NUM_CHAR_VECS   8
 
@@ -94,6 +96,28 @@ LONG bconout2(WORD dev, WORD b)
     return 1L;
 }
 
+#if CONF_WITH_BATCHED_CONOUT
+/*
+ * con_outs - output a string of printable characters to the console
+ *
+ * called directly by the BDOS, bypassing the BIOS trap.  this is only
+ * done if nobody has intercepted the trap or redirected the console
+ * output vector, otherwise 0 is returned and the caller must output
+ * the characters one by one.
+ */
+LONG con_outs(const UBYTE *s, WORD n)
+{
+    if (!(boot_status & CHARDEV_AVAILABLE))
+        return 0L;
+    if ((VEC_BIOS != biostrap) || (bconout_vec[2] != bconout2))
+        return 0L;
+
+    cputs(s, n);
+
+    return n;
+}
+#endif
+
 /* bconout5 - raw console output. */
 LONG bconout5(WORD dev, WORD ch)
 {
@@ -475,24 +475,18 @@ void move_cursor(int x, int y)
  * ch.w      ascii code for character
  */
 
-void ascii_out(int ch)
-{
-    UBYTE * src, * dst;
-    BOOL visible;                       /* was the cursor visible? */
-
-    src = char_addr(ch);                /* a0 -> get character source */
-    if (src == NULL)
-        return;                         /* no valid character */
-
-    dst = v_cur_ad;                     /* a1 -> get destination */
-
-    visible = v_stat_0 & M_CVIS;        /* test visibility bit */
-    if (visible) {
-        v_stat_0 &= ~M_CVIS;                    /* start of critical section */
-    }
+/*
+ * put_cell - put a character cell at the cursor position & advance the cursor
+ *
+ * in:
+ *
+ * src       pointer to the character source cell
+ */
 
+static void put_cell(UBYTE *src)
+{
     /* put the cell out (this covers the cursor) */
-    cell_xfer(src, dst);
+    cell_xfer(src, v_cur_ad);
 
     /* advance the cursor and update cursor address and coordinates */
     if (next_cell()) {
@@ -513,8 +507,30 @@ void ascii_out(int ch)
         }
         v_cur_ad = cell;                /* update cursor address */
     }
+}
+
+
+
+/*
+ * hide_cursor/show_cursor - bracket output of cells
+ *
+ * the cursor is hidden while the cells are written, and displayed
+ * again at the end if it was visible
+ */
+
+static BOOL hide_cursor(void)
+{
+    BOOL visible = v_stat_0 & M_CVIS;   /* test visibility bit */
 
-    /* if visible */
+    if (visible) {
+        v_stat_0 &= ~M_CVIS;            /* start of critical section */
+    }
+
+    return visible;
+}
+
+static void show_cursor(BOOL visible)
+{
     if (visible) {
         neg_cell(v_cur_ad);             /* display cursor. */
         v_stat_0 |= M_CSTATE;           /* set state flag (cursor on). */
@@ -529,6 +545,52 @@ void ascii_out(int ch)
 
 
 
+void ascii_out(int ch)
+{
+    UBYTE * src;
+    BOOL visible;                       /* was the cursor visible? */
+
+    src = char_addr(ch);                /* a0 -> get character source */
+    if (src == NULL)
+        return;                         /* no valid character */
+
+    visible = hide_cursor();
+    put_cell(src);
+    show_cursor(visible);
+}
+
+
+
+#if CONF_WITH_BATCHED_CONOUT
+/*
+ * ascii_outs - prints a string of ascii characters on the screen
+ *
+ * same as calling ascii_out() for each character, but the cursor is
+ * only hidden & displayed once
+ *
+ * in:
+ *
+ * s         pointer to characters
+ * n         number of characters
+ */
+
+void ascii_outs(const UBYTE *s, WORD n)
+{
+    UBYTE * src;
+    BOOL visible;                       /* was the cursor visible? */
+
+    visible = hide_cursor();
+    while (n-- > 0) {
+        src = char_addr(*s++);
+        if (src)
+            put_cell(src);
+    }
+    show_cursor(visible);
+}
+#endif
+
+
+
 #if CONF_WITH_VIDEL
 /*
  * blank_out16 - blank_out() for Falcon 16-bit graphics
@@ -49,6 +49,9 @@ extern WORD sav_cur_y;          /* saved cursor cell y */
 /* Prototypes */
 
 void ascii_out(int);
+#if CONF_WITH_BATCHED_CONOUT
+void ascii_outs(const UBYTE *s, WORD n);
+#endif
 void move_cursor(int, int);
 void blank_out (int, int, int, int);
 void invert_cell(int, int);
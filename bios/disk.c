@@ -26,6 +26,7 @@
 #include "acsi.h"
 #include "scsi.h"
 #include "sd.h"
+#include "ramdisk.h"
 #include "../bdos/bdosstub.h"
 #include "string.h"
 
@@ -254,6 +255,34 @@ void disk_init_all(void)
 #endif
 }
 
+#if CONF_WITH_RAMDISK
+/*
+ * disk_init_late
+ *
+ * adds the partitions of a unit which only becomes available after
+ * disk_init_all(), using the drive letters that are still free
+ */
+void disk_init_late(UWORD unit)
+{
+    LONG devices_available = 0L;
+    LONG bitmask;
+    int i;
+
+    for (i = 2, bitmask = 0x04L; i < BLKDEVNUM; i++, bitmask <<= 1)
+        if (!(drvbits & bitmask))
+            devices_available |= bitmask;
+
+    units[unit].drivemap = devices_available;
+    disk_init_one(unit,&devices_available);
+    units[unit].drivemap ^= devices_available;  /* the ones allocated */
+
+    if (units[unit].features&UNIT_REMOVABLE)
+        drvrem |= units[unit].drivemap;
+
+    KDEBUG(("disk_init_late(%d): drivemap=0x%08lx\n",unit,units[unit].drivemap));
+}
+#endif /* CONF_WITH_RAMDISK */
+
 /*
  * media change detection
  */
@@ -303,6 +332,11 @@ LONG disk_mediach(UWORD unit)
         ret = sd_ioctl(reldev,GET_MEDIACHANGE,NULL);
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_ioctl(reldev,GET_MEDIACHANGE,NULL);
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         ret = EUNDEV;
     }
@@ -777,6 +811,11 @@ static LONG natfeats_inquire(UWORD unit, ULONG *blocksize, ULONG *deviceflags, c
 {
     UWORD major = unit - NUMFLOPPIES;
 
+#if CONF_WITH_RAMDISK
+    if (unit == RAMDISK_UNIT)   /* always handled by EmuTOS */
+        return EUNDEV;
+#endif
+
     if (!get_xhdi_nfid())
         return EUNDEV;
 
@@ -827,6 +866,11 @@ static LONG internal_inquire(UWORD unit, ULONG *blocksize, ULONG *deviceflags, c
         flags = XH_TARGET_REMOVABLE;    /* medium is removable */
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_ioctl(reldev,GET_DISKNAME,name);
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         ret = EUNDEV;
     }
@@ -913,6 +957,13 @@ LONG disk_get_capacity(UWORD unit, ULONG *blocks, ULONG *blocksize)
             return ret;
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_ioctl(reldev,GET_DISKINFO,info);
+        if (ret < 0)
+            return ret;
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         return EUNDEV;
     }
@@ -925,8 +976,8 @@ LONG disk_get_capacity(UWORD unit, ULONG *blocks, ULONG *blocksize)
     return 0;
 }
 
-/* Unit read/write */
-LONG disk_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
+/* Unit read/write, via the bus driver */
+static LONG bus_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
 {
     UWORD major = unit - NUMFLOPPIES;
     LONG ret;
@@ -981,6 +1032,11 @@ LONG disk_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
         KDEBUG(("sd_rw() returned %ld\n", ret));
         break;
 #endif /* CONF_WITH_SDMMC */
+#if CONF_WITH_RAMDISK
+    case RAMDISK_BUS:
+        ret = ramdisk_rw(rw, sector, count, buf, reldev);
+        break;
+#endif /* CONF_WITH_RAMDISK */
     default:
         ret = EUNDEV;
     }
@@ -988,6 +1044,163 @@ LONG disk_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
     return ret;
 }
 
+#if CONF_WITH_DISK_MERGE
+
+/*
+ * write merging
+ *
+ * during a GEMDOS call, writes to the non-removable hard disk units are
+ * copied to the merge buffer instead of being sent to the bus driver.
+ * following writes which continue the same run of sectors are appended
+ * to it, so that GEMDOS's header records, clusters and tail records end
+ * up in a single bus command.  the run is written when a write does not
+ * continue it (keeping the writes in order), before a read which
+ * overlaps it, and at the end of the GEMDOS call (including Pexec() and
+ * Pterm(), which write it before starting or resuming a program, see
+ * proc.c).  reads cannot be held back, so they are never merged.
+ *
+ * since the callers have been told that the data was written, a run
+ * gets the same retries and critical error handling as blkdev_rwabs().
+ * if it still cannot be written, the cached copies of its sectors are
+ * dropped, and the error is returned by disk_merge_end().
+ */
+static UBYTE *dm_buf;           /* the merge buffer, NULL if none */
+static UWORD dm_unit;           /* unit of the pending run */
+static ULONG dm_sector;         /* first sector of the pending run */
+static UWORD dm_count;          /* number of sectors in it, 0 if none */
+static LONG dm_error;           /* first error from writing a run */
+static BOOL dm_active;          /* TRUE during a GEMDOS call */
+
+/*
+ * disk_merge_init - allocate the merge buffer
+ *
+ * this is called once GEMDOS memory management is available
+ */
+void disk_merge_init(void)
+{
+    dm_buf = xmxalloc(CONF_DISK_MERGE_SIZE, MX_STRAM);
+    KDEBUG(("disk_merge_init(): buffer at %p\n", dm_buf));
+}
+
+/* write the pending run, if any */
+static void dm_flush(void)
+{
+    LONG ret;
+    UWORD count = dm_count;
+    int retries;
+
+    if (!count)
+        return;
+    dm_count = 0;
+
+    do {
+        retries = RWABS_RETRIES;
+        do {
+            ret = bus_rw(dm_unit, RW_WRITE, dm_sector, count, dm_buf);
+        } while ((ret < 0) && (ret != E_CHNG) && (--retries > 0));
+        if (ret < 0)
+            ret = blkdev_critic(ret, dm_unit);
+    } while (ret == CRITIC_RETRY_REQUEST);
+
+    if (ret < 0) {
+        KDEBUG(("dm_flush(): unit %u, sector %lu: error %ld\n", dm_unit, dm_sector, ret));
+#if CONF_WITH_BLKDEV_CACHE
+        blkdev_cache_drop(dm_unit, dm_sector, count);
+#endif
+        if (!dm_error)
+            dm_error = ret;
+    }
+}
+
+/* TRUE if a write to the unit may be held back */
+static BOOL dm_can_merge(UWORD unit, UWORD rw)
+{
+    if (!dm_active || (rw & RW_NOBYTESWAP))
+        return FALSE;
+
+    if (units[unit].features & (UNIT_REMOVABLE|UNIT_NATFEATS))
+        return FALSE;
+
+#if CONF_WITH_RAMDISK
+    if (unit == RAMDISK_UNIT)
+        return FALSE;
+#endif
+
+    return TRUE;
+}
+
+static LONG dm_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
+{
+    WORD psshift = units[unit].psshift;
+    UWORD maxcount = CONF_DISK_MERGE_SIZE >> psshift;
+
+    if (!(rw & RW_WRITE)) {
+        /* the data must be on the disk before it is read back */
+        if (dm_count && (unit == dm_unit)
+         && (sector < dm_sector + dm_count) && (sector + count > dm_sector))
+            dm_flush();
+        return bus_rw(unit, rw, sector, count, buf);
+    }
+
+    if (!dm_can_merge(unit, rw) || (count >= maxcount)) {
+        dm_flush();
+        return bus_rw(unit, rw, sector, count, buf);
+    }
+
+    if (dm_count && ((unit != dm_unit) || (sector != dm_sector + dm_count)
+                                       || (dm_count + count > maxcount)))
+        dm_flush();
+
+    if (!dm_count) {
+        dm_unit = unit;
+        dm_sector = sector;
+    }
+    memcpy(dm_buf + ((LONG)dm_count << psshift), buf, (LONG)count << psshift);
+    dm_count += count;
+
+    return 0L;
+}
+
+/*
+ * disk_merge_begin - start merging the writes, at the start of a GEMDOS call
+ */
+void disk_merge_begin(void)
+{
+    dm_active = (dm_buf != NULL);
+}
+
+/*
+ * disk_merge_end - write the pending run and stop merging the writes, at
+ * the end of a GEMDOS call or before GEMDOS starts or resumes a program
+ *
+ * returns the first error from writing a run since disk_merge_begin(),
+ * or 0
+ */
+LONG disk_merge_end(void)
+{
+    LONG ret;
+
+    dm_active = FALSE;
+    dm_flush();
+    ret = dm_error;
+    dm_error = 0L;
+
+    return ret;
+}
+
+#endif /* CONF_WITH_DISK_MERGE */
+
+/* Unit read/write */
+LONG disk_rw(UWORD unit, UWORD rw, ULONG sector, UWORD count, UBYTE *buf)
+{
+#if CONF_WITH_DISK_MERGE
+    if (dm_buf)
+        return dm_rw(unit, rw, sector, count, buf);
+#endif
+
+    return bus_rw(unit, rw, sector, count, buf);
+}
+
 /*==== XBIOS functions ====================================================*/
 
 LONG DMAread(LONG sector, WORD count, UBYTE *buf, WORD major)
@@ -995,6 +1208,10 @@ LONG DMAread(LONG sector, WORD count, UBYTE *buf, WORD major)
     UWORD unit = NUMFLOPPIES + major;
     LONG rc;
 
+#if CONF_WITH_BLKDEV_CACHE
+    blkdev_cache_sync(unit, RW_READ);
+#endif
+
     rc = disk_rw(unit, RW_READ, sector, count, buf);
 
     /* TOS invalidates the i-cache here, so be compatible */
@@ -1007,5 +1224,9 @@ LONG DMAwrite(LONG sector, WORD count, const UBYTE *buf, WORD major)
 {
     UWORD unit = NUMFLOPPIES + major;
 
+#if CONF_WITH_BLKDEV_CACHE
+    blkdev_cache_sync(unit, RW_WRITE);
+#endif
+
     return disk_rw(unit, RW_WRITE, sector, count, CONST_CAST(UBYTE *, buf));
 }
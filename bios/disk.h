@@ -19,7 +19,13 @@
 
 #define DEVICES_PER_BUS     8
 
+#if CONF_WITH_RAMDISK
+#define RAMDISK_BUS         (SDMMC_BUS+1)   /* pseudo bus with a single unit */
+#define RAMDISK_UNIT        GET_UNITNUM(RAMDISK_BUS,0)
+#define UNITSNUM            (RAMDISK_UNIT+1)
+#else
 #define UNITSNUM            (NUMFLOPPIES+(DEVICES_PER_BUS*(MAX_BUS+1)))
+#endif
 
 #define GET_BUS(major)          ((major)/DEVICES_PER_BUS)
 #define IS_ACSI_DEVICE(major)   (GET_BUS(major) == ACSI_BUS)
@@ -108,6 +114,14 @@ LONG DMAwrite(LONG sector, WORD count, const UBYTE *buf, WORD major);
 /* partition detection */
 
 void disk_init_all(void);
+#if CONF_WITH_DISK_MERGE
+void disk_merge_init(void);
+void disk_merge_begin(void);
+LONG disk_merge_end(void);
+#endif
+#if CONF_WITH_RAMDISK
+void disk_init_late(UWORD unit);
+#endif
 LONG disk_mediach(UWORD unit);
 void disk_rescan(UWORD unit);
 
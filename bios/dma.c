@@ -1,14 +1,21 @@
 /*
  * dma.c - DMA disk routines
  *
- * Copyright (C) 2011-2019 The EmuTOS development team
+ * Copyright (C) 2011-2024 The EmuTOS development team
  *
  * This file is distributed under the GPL, version 2 or at your
  * option any later version.  See doc/license.txt for details.
  */
 
+/* #define ENABLE_KDEBUG */
+
 #include "emutos.h"
 #include "dma.h"
+#include "biosdefs.h"
+#include "biosext.h"
+#include "has.h"
+#include "string.h"
+#include "../bdos/bdosstub.h"
 
 void set_dma_addr(UBYTE *addr)
 {
@@ -18,3 +25,132 @@ void set_dma_addr(UBYTE *addr)
     DMA->addr_med = b[2];
     DMA->addr_high = b[1];
 }
+
+#if CONF_WITH_DMA_BOUNCE
+
+/*
+ * the bounce pool is used by the ACSI and Falcon SCSI drivers when the
+ * caller's buffer cannot be reached by DMA.  it is split into two halves
+ * of dmabounce_secs sectors each: while the DMA chip transfers a chunk
+ * to or from one half, the CPU copies the previous (read) or next (write)
+ * chunk from or to the other half.
+ */
+#define DMA_BOUNCE_MINSECS  16      /* smaller halves are not worth it */
+#define DMA_BOUNCE_FRACTION 32      /* use at most 1/32 of free ST-RAM */
+
+UBYTE *dmabounce;
+static UWORD dmabounce_secs;
+
+/* the copy that the driver should do while the next DMA is running */
+static UBYTE *ovl_dst;
+static const UBYTE *ovl_src;
+static ULONG ovl_len;
+
+/*
+ * dma_bounce_init - allocate the bounce pool, once GEMDOS is initialized
+ *
+ * this is only done if there is Alt-RAM, and some hard disk can only
+ * do DMA to ST-RAM
+ */
+void dma_bounce_init(void)
+{
+    LONG secs;
+
+    if (!has_alt_ram || (blkdev_mxalloc_mode() != MX_STRAM))
+        return;
+
+    secs = (LONG)xmxalloc(-1L, MX_STRAM) / DMA_BOUNCE_FRACTION;
+    if (secs > CONF_DMA_BOUNCE_SIZE)
+        secs = CONF_DMA_BOUNCE_SIZE;
+    secs /= 2 * SECTOR_SIZE;
+    if (secs < DMA_BOUNCE_MINSECS)
+        return;
+
+    dmabounce = xmxalloc(secs * 2 * SECTOR_SIZE, MX_STRAM);
+    if (dmabounce)
+        dmabounce_secs = secs;
+
+    KDEBUG(("dma_bounce_init(): 2 x %u sectors at %p\n",dmabounce_secs,dmabounce));
+}
+
+/*
+ * dma_overlap_copy - do the pending copy, if any
+ *
+ * the drivers call this as soon as they have started a DMA transfer.
+ * dma_bounce_rw() calls it again after each chunk, in case the driver
+ * did not get that far (error, programmed i/o).
+ */
+void dma_overlap_copy(void)
+{
+    if (ovl_len) {
+        memcpy(ovl_dst, ovl_src, ovl_len);
+        ovl_len = 0;
+    }
+}
+
+static void dma_overlap_set(UBYTE *dst, const UBYTE *src, ULONG len)
+{
+    ovl_dst = dst;
+    ovl_src = src;
+    ovl_len = len;
+}
+
+/*
+ * dma_bounce_rw - transfer sectors via the bounce pool
+ *
+ * the request is split into chunks of at most maxsecs sectors, which
+ * fit in one half of the pool.  like the drivers' own loops, each chunk
+ * is tried twice.
+ */
+LONG dma_bounce_rw(UWORD rw, ULONG sector, UWORD count, UBYTE *buf, WORD dev,
+                   UWORD maxsecs, DMA_XFER xfer)
+{
+    UBYTE *half[2];
+    UWORD numsecs, nextsecs;
+    LONG ret = 0L;
+    int i, retry;
+
+    if (maxsecs > dmabounce_secs)
+        maxsecs = dmabounce_secs;
+    half[0] = dmabounce;
+    half[1] = dmabounce + (ULONG)dmabounce_secs * SECTOR_SIZE;
+
+    numsecs = (count > maxsecs) ? maxsecs : count;
+    if (rw)
+        memcpy(half[0], buf, (ULONG)numsecs * SECTOR_SIZE);
+
+    for (i = 0; count; i ^= 1)
+    {
+        count -= numsecs;
+        nextsecs = (count > maxsecs) ? maxsecs : count;
+
+        /* when writing, fill the other half during this transfer */
+        if (rw && nextsecs)
+            dma_overlap_set(half[i^1], buf + (ULONG)numsecs * SECTOR_SIZE,
+                            (ULONG)nextsecs * SECTOR_SIZE);
+
+        for (retry = 0; retry < 2; retry++)
+            if ((ret=xfer(rw, sector, numsecs, half[i], dev)) == 0)
+                break;
+        dma_overlap_copy();
+        if (ret)
+            break;
+
+        /* when reading, empty this half during the next transfer */
+        if (!rw)
+        {
+            if (nextsecs)
+                dma_overlap_set(buf, half[i], (ULONG)numsecs * SECTOR_SIZE);
+            else
+                memcpy(buf, half[i], (ULONG)numsecs * SECTOR_SIZE);
+        }
+
+        buf += (ULONG)numsecs * SECTOR_SIZE;
+        sector += numsecs;
+        numsecs = nextsecs;
+    }
+
+    return ret;
+}
+
+#endif /* CONF_WITH_DMA_BOUNCE */
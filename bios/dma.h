@@ -1,7 +1,7 @@
 /*
  * dma.h - dma definitions
  *
- * Copyright (C) 2001-2019 The EmuTOS development team
+ * Copyright (C) 2001-2024 The EmuTOS development team
  *
  * Authors:
  *  LVL   Laurent Vogel
@@ -61,4 +61,16 @@ struct dma {
 
 void set_dma_addr(UBYTE *addr);
 
+#if CONF_WITH_DMA_BOUNCE
+/* transfers one chunk of a dma_bounce_rw() request, like do_scsi_rw() */
+typedef LONG (*DMA_XFER)(UWORD rw, ULONG sector, UWORD count, UBYTE *buf, WORD dev);
+
+extern UBYTE *dmabounce;        /* ST-RAM bounce pool, NULL if none */
+
+void dma_bounce_init(void);
+LONG dma_bounce_rw(UWORD rw, ULONG sector, UWORD count, UBYTE *buf, WORD dev,
+                   UWORD maxsecs, DMA_XFER xfer);
+void dma_overlap_copy(void);
+#endif
+
 #endif /* DMA_H */
@@ -33,6 +33,7 @@
 #include "intmath.h"
 #include "amiga.h"
 #include "lisa.h"
+#include "../bdos/bdosstub.h"
 
 
 /*==== Introduction =======================================================*/
@@ -123,6 +124,14 @@ static WORD flopwtrack(UBYTE *buf, WORD dev, WORD track, WORD side,
 /* initialise a floppy for hdv_init */
 static void flop_detect_drive(WORD dev);
 
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+static WORD trkbuf_read(UBYTE *buf, WORD dev, WORD sect, WORD track,
+                    WORD side, WORD count, WORD spt);
+#define trkbuf_discard(dev) do { if ((dev) == trkbuf_dev) trkbuf_dev = -1; } while (0)
+#else
+#define trkbuf_discard(dev)
+#endif
+
 #if CONF_WITH_FDC
 
 /* called at start and end of a floppy access. */
@@ -286,6 +295,30 @@ static struct flop_info finfo[NUMFLOPPIES];
 
 #define IS_VALID_FLOPPY_DEVICE(dev) ((UWORD)(dev) < NUMFLOPPIES && units[dev].valid)
 
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+/*==== Track cache ========================================================*/
+
+/* when floppy_rw() reads part of a track/side, the whole track/side is
+ * read into trkbuf, and later reads from it are served from memory.
+ * since a diskette may be swapped without notice (see above), the
+ * contents are only trusted for TRKBUF_LIFE ticks after being read, and
+ * while flopvbl() has seen no write-protect change.  the buffer is also
+ * discarded on any write to that drive, on media change and on eject.
+ *
+ * trkbuf is allocated in ST-RAM by flop_trkbuf_init(), so that flopio()
+ * can read into it directly.  trkbuf_dev is -1 if the buffer is empty.
+ */
+#define TRKBUF_LIFE     CLOCKS_PER_SEC
+#define TRKBUF_DD_SECS  11      /* enough for extended DD formats */
+#define TRKBUF_HD_SECS  22      /* and HD formats */
+
+static UBYTE *trkbuf;
+static WORD trkbuf_secs;        /* capacity in sectors */
+static WORD trkbuf_dev = -1;
+static WORD trkbuf_track, trkbuf_side, trkbuf_spt;
+static ULONG trkbuf_time;       /* hz_200 when the track was read */
+#endif
+
 /*==== hdv_init and hdv_boot ==============================================*/
 
 static void flop_init(WORD dev)
@@ -481,6 +514,7 @@ LONG flop_mediach(WORD dev)
         KDEBUG(("flop_mediach(): no media change detected by flopvbl()\n"));
         return MEDIANOCHANGE;
     }
+    trkbuf_discard(dev);
 
     /*
      * the latch has been set, so we have a possible or definite diskette
@@ -596,6 +630,11 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
         numsecs = spt - start_relsec;
         KDEBUG(("floppy_rw() #1: track=%d, side=%d, start=%d, count=%d\n",
                 track,side,start_relsec+1,numsecs));
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+        if (!(rw & RW_WRITE))
+            err = trkbuf_read(buf, dev, start_relsec+1, track, side, numsecs, spt);
+        else
+#endif
         err = flopio_ver(buf, rw, dev, start_relsec+1, track, side, numsecs);
         if (err)
             return err;
@@ -617,6 +656,11 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
         }
         KDEBUG(("floppy_rw() #2: track=%d, side=%d, start=%d, count=%d\n",
                 track,side,1,spt));
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+        if (!(rw & RW_WRITE))
+            err = trkbuf_read(buf, dev, 1, track, side, spt, spt);
+        else
+#endif
         err = flopio_ver(buf, rw, dev, 1, track, side, spt);
         if (err)
             return err;
@@ -636,6 +680,11 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
     numsecs = end_relsec - start_relsec + 1;
     KDEBUG(("floppy_rw() #3: track=%d, side=%d, start=%d, count=%d\n",
             track,side,start_relsec+1,numsecs));
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+    if (!(rw & RW_WRITE))
+        err = trkbuf_read(buf, dev, start_relsec+1, track, side, numsecs, spt);
+    else
+#endif
     err = flopio_ver(buf, rw, dev, start_relsec+1, track, side, numsecs);
     if (err)
         return err;
@@ -643,10 +692,82 @@ LONG floppy_rw(WORD rw, UBYTE *buf, WORD cnt, LONG recnr, WORD spt,
     return 0;
 }
 
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+
+/*
+ * flop_trkbuf_init - allocate the track cache, once GEMDOS is initialized
+ */
+void flop_trkbuf_init(void)
+{
+    WORD dev, secs = 0;
+
+    for (dev = 0; dev < NUMFLOPPIES; dev++) {
+        if (!units[dev].valid)
+            continue;
+        if (finfo[dev].drive_type == HD_DRIVE)
+            secs = TRKBUF_HD_SECS;
+        else if (!secs)
+            secs = TRKBUF_DD_SECS;
+    }
+    if (!secs)
+        return;
+
+    trkbuf = xmxalloc((LONG)secs * SECTOR_SIZE, MX_STRAM);
+    if (trkbuf)
+        trkbuf_secs = secs;
+    trkbuf_dev = -1;
+
+    KDEBUG(("flop_trkbuf_init(): %d sectors at %p\n",trkbuf_secs,trkbuf));
+}
+
+/*
+ * trkbuf_read - read sectors from one track/side via the track cache
+ */
+static WORD trkbuf_read(UBYTE *buf, WORD dev, WORD sect, WORD track,
+                        WORD side, WORD count, WORD spt)
+{
+    WORD err;
+
+    if ((trkbuf_dev == dev) && (trkbuf_track == track) && (trkbuf_side == side)
+     && (trkbuf_spt == spt) && (hz_200 - trkbuf_time < TRKBUF_LIFE)
+     && !finfo[dev].wplatch) {
+        KDEBUG(("trkbuf_read(): hit %d/%d/%d\n",track,side,sect));
+        memcpy(buf, trkbuf + (sect - 1) * SECTOR_SIZE, (LONG)count * SECTOR_SIZE);
+        return 0;
+    }
+
+    /* a whole track is simply read, as is anything we cannot cache */
+    if ((count == spt) || (spt > trkbuf_secs))
+        return flopio(buf, RW_READ, dev, sect, track, side, count);
+
+    trkbuf_dev = -1;
+    err = flopio(trkbuf, RW_READ, dev, 1, track, side, spt);
+    if (err) {
+        /* perhaps a bad sector elsewhere on the track, so just retry ours */
+        return flopio(buf, RW_READ, dev, sect, track, side, count);
+    }
+
+    trkbuf_dev = dev;
+    trkbuf_track = track;
+    trkbuf_side = side;
+    trkbuf_spt = spt;
+    trkbuf_time = hz_200;
+
+    memcpy(buf, trkbuf + (sect - 1) * SECTOR_SIZE, (LONG)count * SECTOR_SIZE);
+
+    return 0;
+}
+
+#endif /* CONF_WITH_FLOPPY_TRACK_CACHE */
+
 #if CONF_WITH_EJECT
 
 void flop_eject(void)
 {
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+    trkbuf_dev = -1;
+#endif
+
 #ifdef MACHINE_LISA
     lisa_flop_eject();
 #endif
@@ -762,6 +883,10 @@ LONG floprd(UBYTE *buf, LONG filler, WORD dev,
 LONG flopwr(const UBYTE *buf, LONG filler, WORD dev,
             WORD sect, WORD track, WORD side, WORD count)
 {
+#if CONF_WITH_BLKDEV_CACHE
+    blkdev_cache_sync(dev, RW_WRITE);
+#endif
+
     return flopio(CONST_CAST(UBYTE *, buf), RW_WRITE, dev, sect, track, side, count);
 }
 
@@ -923,6 +1048,10 @@ LONG flopfmt(UBYTE *buf, WORD *skew, WORD dev, WORD spt,
     if (!IS_VALID_FLOPPY_DEVICE(dev))
         return EUNDEV;          /* unknown disk */
 
+#if CONF_WITH_BLKDEV_CACHE
+    blkdev_cache_sync(dev, RW_WRITE);
+#endif
+
     if (magic != 0x87654321UL)
         return EBADSF;          /* just like TOS4 */
 
@@ -1095,6 +1224,9 @@ static WORD flopio(UBYTE *userbuf, WORD rw, WORD dev,
 
     rw &= RW_RW;    /* remove any extraneous bits */
 
+    if (rw == RW_WRITE)
+        trkbuf_discard(dev);
+
     if ((rw == RW_WRITE) && (track == 0) && (sect == 1) && (side == 0)) {
         /* TODO, maybe media changed ? */
     }
@@ -1233,6 +1365,8 @@ static WORD flopwtrack(UBYTE *userbuf, WORD dev, WORD track, WORD side, WORD tra
     WORD err;
     struct flop_info *f = &finfo[dev];
 
+    trkbuf_discard(dev);
+
     if ((track == 0) && (side == 0)) {
         /* TODO, maybe media changed ? */
     }
@@ -41,6 +41,9 @@ LONG floprate(WORD dev, WORD rate);
 /* internal functions */
 
 void flop_checksum(int floppy, UBYTE *buf);
+#if CONF_WITH_FLOPPY_TRACK_CACHE
+void flop_trkbuf_init(void);
+#endif
 
 #if CONF_WITH_FDC
 
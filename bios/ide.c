@@ -149,11 +149,40 @@ struct IDE
 #define xferswap(a) swpw2(a)
 #define ide_get_and_incr(src,dst) asm volatile("move.l (%1),(%0)+" : "=a"(dst): "a"(src), "0"(dst));
 #define ide_put_and_incr(src,dst) asm volatile("move.l (%0)+,(%1)" : "=a"(src): "a"(dst), "0"(src));
+#define XFERSIZE    "l"
+#define XFERSWAP(r) "ror.w #8," r "\n\tswap " r "\n\tror.w #8," r "\n\tswap " r "\n\t"
 #else
 #define XFERWIDTH   UWORD
 #define xferswap(a) swpw(a)
 #define ide_get_and_incr(src,dst) asm volatile("move.w (%1),(%0)+" : "=a"(dst): "a"(src), "0"(dst));
 #define ide_put_and_incr(src,dst) asm volatile("move.w (%0)+,(%1)" : "=a"(src): "a"(dst), "0"(src));
+#define XFERSIZE    "w"
+#define XFERSWAP(r) "ror.w #8," r "\n\t"
+#endif
+
+#ifndef __mcoldfire__
+/*
+ * byteswapped transfers of 8 XFERWIDTH items (16/32 bytes) at a time.
+ * the data must go through registers to be swapped, so we use d0-d7:
+ * the buffer side is then handled by a single movem.
+ * note that ide_put_swap8() increments src implicitly, but that the
+ * caller of ide_get_swap8() must increment dst.
+ */
+#define XFER8(op)   op("d0") op("d1") op("d2") op("d3") \
+                    op("d4") op("d5") op("d6") op("d7")
+#define XFERLOAD(r)     "move." XFERSIZE " (%1)," r "\n\t"
+#define XFERSTORE(r)    "move." XFERSIZE " " r ",(%1)\n\t"
+
+#define ide_get_swap8(src,dst) \
+    asm volatile(XFER8(XFERLOAD) XFER8(XFERSWAP) \
+                 "movem." XFERSIZE " d0-d7,(%0)" \
+                 : : "a"(dst), "a"(src) \
+                 : "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc", "memory");
+#define ide_put_swap8(src,dst) \
+    asm volatile("movem." XFERSIZE " (%0)+,d0-d7\n\t" \
+                 XFER8(XFERSWAP) XFER8(XFERSTORE) \
+                 : "=a"(src) : "a"(dst), "0"(src) \
+                 : "d0", "d1", "d2", "d3", "d4", "d5", "d6", "d7", "cc", "memory");
 #endif
 
 #if CONF_ATARI_HARDWARE
@@ -235,12 +264,16 @@ struct IDE
 #define IDE_ERROR_ABRT  (1 << 2)
 
 /*
- * maximum number of sectors per physical i/o.  this MUST not exceed 256,
- * at least for LBA28-style commands.  the best performance is obtained
- * if this is a multiple of the sectors-per-interrupt value supported by
- * the drive(s) in multiple mode.
+ * maximum number of sectors per physical i/o.  a sector count of 0 means
+ * 256 sectors for LBA28-style (and CHS) commands, and 65536 sectors for
+ * LBA48-style commands; since ide_rw() gets a UWORD count, the latter
+ * limit is never reached.  issuing the largest commands minimizes the
+ * per-command overhead: in multiple mode, the drive still interrupts
+ * every 'spi' sectors.
  */
-#define MAXSECS_PER_IO  32
+#define MAXSECS_PER_IO          256
+#define MAXSECS_PER_IO_LBA48    65535U
+#define MAX_LBA28_SECTOR        0x0FFFFFFFUL
 
 
 /* interface/device info */
@@ -1007,6 +1040,14 @@ static void ide_get_data(volatile struct IDE *interface,UBYTE *buffer,ULONG buff
 #endif
 
     if (need_byteswap) {
+#ifndef __mcoldfire__
+        end = (XFERWIDTH *)(buffer + (bufferlen & ~(8*sizeof(XFERWIDTH)-1)));  /* mask must match unrolled loop */
+        while (p < end) {
+            /* transfer 16/32 bytes in a row */
+            ide_get_swap8(&(interface->data), p);
+            p += 8;
+        }
+#else
         end = (XFERWIDTH *)(buffer + (bufferlen & ~(16-1)));    /* mask must match unrolled loop */
         while (p < end) {
             XFERWIDTH temp;
@@ -1028,6 +1069,7 @@ static void ide_get_data(volatile struct IDE *interface,UBYTE *buffer,ULONG buff
             xferswap(temp);
             *p++ = temp;
         }
+#endif
 
         /* transfer remainder 2 bytes at a time */
         p2 = (UWORD *)p;
@@ -1072,6 +1114,19 @@ static void ide_get_data(volatile struct IDE *interface,UBYTE *buffer,ULONG buff
     }
 }
 
+/*
+ * TRUE if a transfer needs an LBA48-style command: either it goes beyond
+ * the LBA28 range, or it is too big for a single LBA28-style command.
+ * otherwise we use LBA28, which needs fewer register accesses.
+ */
+static BOOL need_lba48(struct IFINFO_DEV *devinfo,ULONG sector,UWORD count)
+{
+    if (!(devinfo->options & LBA48_ACTIVE))
+        return FALSE;
+
+    return (count > MAXSECS_PER_IO) || (sector + count - 1 > MAX_LBA28_SECTOR);
+}
+
 /*
  * read from the IDE device
  */
@@ -1091,14 +1146,12 @@ static LONG ide_read(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UB
     /*
      * if READ SECTOR and MULTIPLE MODE, set cmd & spi accordingly
      *
-     * If the sector is > LBA28 range use LBA48 if supported.
-     * This aids performance in for LBA28 addressable sectors.
+     * Use LBA48 if supported and needed (see need_lba48()).
      */
     spi = 1;
     if ((cmd == IDE_CMD_READ_SECTOR)
      && (info->dev[dev].options & MULTIPLE_MODE_ACTIVE)) {
-        if ((info->dev[dev].options & LBA48_ACTIVE) &&
-            (sector > 0x0FFFFFFFUL)) {
+        if (need_lba48(&info->dev[dev],sector,count)) {
             cmd = IDE_CMD_READ_MULTIPLE_EX;
         } else {
             cmd = IDE_CMD_READ_MULTIPLE;
@@ -1107,9 +1160,8 @@ static LONG ide_read(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,UB
         KDEBUG(("spi=%u\n", spi));
     }
 
-    if ((info->dev[dev].options & LBA48_ACTIVE) &&
-        (sector > 0x0FFFFFFFUL) &&
-        (cmd == IDE_CMD_READ_SECTOR)) {
+    if ((cmd == IDE_CMD_READ_SECTOR) &&
+        need_lba48(&info->dev[dev],sector,count)) {
        cmd = IDE_CMD_READ_SECTOR_EX;
     }
 
@@ -1181,6 +1233,13 @@ static void ide_put_data(volatile struct IDE *interface,UBYTE *buffer,ULONG buff
     UWORD *end2 = (UWORD *)(buffer + bufferlen);
 
     if (need_byteswap) {
+#ifndef __mcoldfire__
+        end = (XFERWIDTH *)(buffer + (bufferlen & ~(8*sizeof(XFERWIDTH)-1)));  /* mask must match unrolled loop */
+        while (p < end) {
+            /* transfer 16/32 bytes in a row */
+            ide_put_swap8(p, &(interface->data));
+        }
+#else
         end = (XFERWIDTH *)(buffer + (bufferlen & ~(16-1)));    /* mask must match unrolled loop */
         while (p < end) {
             XFERWIDTH temp;
@@ -1202,6 +1261,7 @@ static void ide_put_data(volatile struct IDE *interface,UBYTE *buffer,ULONG buff
             xferswap(temp);
             interface->data = temp;
         }
+#endif
 
         /* transfer remainder 2 bytes at a time */
         p2 = (UWORD *)p;
@@ -1265,23 +1325,20 @@ static LONG ide_write(UBYTE cmd,UWORD ifnum,UWORD dev,ULONG sector,UWORD count,U
     /*
      * if WRITE SECTOR and MULTIPLE MODE, set cmd & spi accordingly
      *
-     * If the sector is > LBA28 range use LBA48 if supported.
-     * This aids performance in for LBA28 addressable sectors.
+     * Use LBA48 if supported and needed (see need_lba48()).
      */
     spi = 1;
     if ((cmd == IDE_CMD_WRITE_SECTOR)
      && (info->dev[dev].options & MULTIPLE_MODE_ACTIVE)) {
-        if ((info->dev[dev].options & LBA48_ACTIVE) &&
-            (sector > 0x0FFFFFFFUL))
+        if (need_lba48(&info->dev[dev],sector,count))
             cmd = IDE_CMD_WRITE_MULTIPLE_EX;
         else
             cmd = IDE_CMD_WRITE_MULTIPLE;
         spi = info->dev[dev].spi;
     }
 
-    if ((info->dev[dev].options & LBA48_ACTIVE) &&
-        (sector > 0x0FFFFFFFUL) &&
-        (cmd == IDE_CMD_WRITE_SECTOR)) {
+    if ((cmd == IDE_CMD_WRITE_SECTOR) &&
+        need_lba48(&info->dev[dev],sector,count)) {
        cmd = IDE_CMD_WRITE_SECTOR_EX;
     }
 
@@ -1337,7 +1394,7 @@ LONG ide_rw(WORD rw,ULONG sector,UWORD count,UBYTE *buf,WORD dev,BOOL need_bytes
 {
     UBYTE *p;
     UWORD ifnum;
-    WORD maxsecs_per_io = MAXSECS_PER_IO;
+    UWORD maxsecs_per_io;
     BOOL use_tmpbuf = FALSE;
     LONG ret;
 
@@ -1347,6 +1404,9 @@ LONG ide_rw(WORD rw,ULONG sector,UWORD count,UBYTE *buf,WORD dev,BOOL need_bytes
     ifnum = dev / 2;/* i.e. primary IDE, secondary IDE, ... */
     dev &= 1;       /* 0 or 1 */
 
+    maxsecs_per_io = (ifinfo[ifnum].dev[dev].options & LBA48_ACTIVE) ?
+                        MAXSECS_PER_IO_LBA48 : MAXSECS_PER_IO;
+
     rw &= RW_RW;    /* we just care about read or write for now */
 
     /*
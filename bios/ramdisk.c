@@ -0,0 +1,245 @@
+/*
+ * ramdisk.c - RAM disk routines
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+/* #define ENABLE_KDEBUG */
+
+#include "emutos.h"
+#include "disk.h"
+#include "blkdev.h"
+#include "gemerror.h"
+#include "ramdisk.h"
+#include "machine.h"
+#include "nvram.h"
+#include "bootparams.h"
+#include "string.h"
+#include "../bdos/bdosstub.h"
+
+#if CONF_WITH_RAMDISK
+
+/*
+ * The RAM disk is the only unit of the pseudo bus RAMDISK_BUS.  It is
+ * created by ramdisk_init() once GEMDOS can allocate memory, then it
+ * is registered like a hard disk without partition table, so blkdev
+ * and XHDI handle it like any other unit.
+ *
+ * Its size comes from the first non-zero value of:
+ *  - the ramtos boot parameter ramdisk_size (in bytes), which EMUTOS.PRG
+ *    sets from its command line (in KB, see util/boot.c); the other
+ *    loaders leave it at 0,
+ *  - the NVRAM byte NVRAM_RAMDISK: bits 0-6 are the size in 256 KB
+ *    units, and bit 7 requests that the contents survive a warm reset,
+ *  - CONF_RAMDISK_SIZE.
+ *
+ * The sector before the data holds a header, which tells on a warm
+ * reset whether the memory still contains the same RAM disk.
+ */
+#define NVRAM_RAMDISK       40
+#define NVRAM_RAMDISK_KEEP  0x80
+#define NVRAM_RAMDISK_UNIT  (256*1024L)
+
+#define RAMDISK_MAGIC       0x52414d44L     /* 'RAMD' */
+#define RAMDISK_MINSECS     128             /* 64 KB */
+#define RAMDISK_MAXSECS     (MAX_FAT16_CLUSTERS*64L)
+#define RAMDISK_ROOTDIR     256             /* root directory entries */
+
+typedef struct {
+    ULONG magic;
+    ULONG secs;
+    UBYTE *data;
+} RAMDISK_HEADER;
+
+static UBYTE *ramdisk_data;
+static ULONG ramdisk_secs;
+
+static void setiword(UBYTE *addr, UWORD value)
+{
+    addr[0] = LOBYTE(value);
+    addr[1] = HIBYTE(value);
+}
+
+/*
+ * create an empty FAT filesystem: FAT16 unless the disk is too small
+ * (the FAT type is determined by the cluster count)
+ */
+static void ramdisk_format(UBYTE *data, ULONG secs)
+{
+    struct fat16_bs *bs = (struct fat16_bs *)data;
+    ULONG clusters, datrec;
+    UWORD spc, fsiz, rdlen;
+    UBYTE *fat;
+    int i;
+
+    /* smallest cluster size which keeps the cluster count valid for FAT16 */
+    for (spc = 1; (secs / spc) > MAX_FAT16_CLUSTERS; spc <<= 1)
+        ;
+    rdlen = RAMDISK_ROOTDIR * 32 / SECTOR_SIZE;
+
+    /* the FATs are sized for 16-bit entries, which is enough for FAT12 too */
+    clusters = (secs - 1 - rdlen) / spc;
+    fsiz = ((clusters + 2) * 2 + SECTOR_SIZE - 1) / SECTOR_SIZE;
+    datrec = 1 + 2 * fsiz + rdlen;
+    clusters = (secs - datrec) / spc;
+
+    bzero(data, datrec * SECTOR_SIZE);
+
+    setiword(bs->bps, SECTOR_SIZE);
+    bs->spc = spc;
+    setiword(bs->res, 1);
+    bs->fat = 2;
+    setiword(bs->dir, RAMDISK_ROOTDIR);
+    if (secs < 0x10000L)
+        setiword(bs->sec, secs);
+    else
+    {
+        setiword(bs->sec2, LOWORD(secs));
+        setiword(bs->sec2+2, HIWORD(secs));
+    }
+    bs->media = 0xf8;
+    setiword(bs->spf, fsiz);
+    bs->ext = 0x29;         /* label & fstype are valid */
+    memcpy(bs->label, "RAMDISK    ", 11);
+    memcpy(bs->fstype, (clusters > MAX_FAT12_CLUSTERS) ? "FAT16   " : "FAT12   ", 8);
+    data[510] = 0x55;       /* needed to be recognised as partitionless */
+    data[511] = 0xaa;
+
+    /* reserved FAT entries for media 0xf8 */
+    for (i = 0, fat = data + SECTOR_SIZE; i < 2; i++, fat += (ULONG)fsiz * SECTOR_SIZE)
+    {
+        fat[0] = 0xf8;
+        fat[1] = 0xff;
+        fat[2] = 0xff;
+        if (clusters > MAX_FAT12_CLUSTERS)
+            fat[3] = 0xff;
+    }
+
+    KDEBUG(("ramdisk_format(): %lu sectors, %lu clusters of %u sectors\n",
+            secs, clusters, spc));
+}
+
+/*
+ * get the requested size in bytes, and whether to keep the contents
+ */
+static ULONG ramdisk_size_wanted(BOOL *keep)
+{
+    ULONG size = CONF_RAMDISK_SIZE;
+#if CONF_WITH_NVRAM
+    UBYTE val;
+#endif
+
+    *keep = CONF_RAMDISK_KEEP;
+
+#if CONF_WITH_NVRAM
+    if ((nvmaccess(0, NVRAM_RAMDISK, 1, &val) == 0) && (val & ~NVRAM_RAMDISK_KEEP))
+    {
+        size = (val & ~NVRAM_RAMDISK_KEEP) * NVRAM_RAMDISK_UNIT;
+        if (val & NVRAM_RAMDISK_KEEP)
+            *keep = TRUE;
+    }
+#endif
+
+#if EMUTOS_LIVES_IN_RAM
+    if (ramdisk_size)
+        size = ramdisk_size;
+#endif
+
+    return size;
+}
+
+void ramdisk_init(void)
+{
+    RAMDISK_HEADER *hdr;
+    UBYTE *data;
+    ULONG secs;
+    BOOL keep;
+
+    secs = ramdisk_size_wanted(&keep) / SECTOR_SIZE;
+    if (secs < RAMDISK_MINSECS)
+        return;
+    if (secs > RAMDISK_MAXSECS)
+        secs = RAMDISK_MAXSECS;
+
+    /*
+     * allocating the same size at the same stage of the boot gives the
+     * same address after a warm reset, unless the memory has changed
+     */
+    hdr = xmxalloc((secs + 1) * SECTOR_SIZE, MX_PREFTTRAM);
+    if (!hdr)
+    {
+        KINFO(("RAM disk: not enough memory for %lu KB\n", secs / 2));
+        return;
+    }
+    data = (UBYTE *)hdr + SECTOR_SIZE;
+
+    if (!keep || FIRST_BOOT || (hdr->magic != RAMDISK_MAGIC)
+     || (hdr->secs != secs) || (hdr->data != data))
+    {
+        ramdisk_format(data, secs);
+        hdr->magic = RAMDISK_MAGIC;
+        hdr->secs = secs;
+        hdr->data = data;
+    }
+
+    ramdisk_data = data;
+    ramdisk_secs = secs;
+
+    blkdev_add_unit(RAMDISK_UNIT);
+}
+
+LONG ramdisk_ioctl(UWORD drv,UWORD ctrl,void *arg)
+{
+    LONG rc;
+    ULONG *info = arg;
+
+    if ((drv != 0) || !ramdisk_secs)
+        return EUNDEV;
+
+    switch(ctrl) {
+    case GET_DISKINFO:
+        info[0] = ramdisk_secs;
+        info[1] = SECTOR_SIZE;
+        rc = E_OK;
+        break;
+    case GET_DISKNAME:
+        strcpy(arg,"EmuTOS RAM disk");
+        rc = E_OK;
+        break;
+    case GET_MEDIACHANGE:
+        rc = MEDIANOCHANGE;
+        break;
+    default:
+        rc = ERR;
+        break;
+    }
+
+    return rc;
+}
+
+LONG ramdisk_rw(WORD rw,LONG sector,WORD count,UBYTE *buf,WORD dev)
+{
+    UBYTE *p;
+    ULONG len;
+
+    if ((dev != 0) || !ramdisk_secs)
+        return EUNDEV;
+
+    if ((sector < 0) || (count < 0) || ((ULONG)sector + count > ramdisk_secs))
+        return ESECNF;
+
+    p = ramdisk_data + (ULONG)sector * SECTOR_SIZE;
+    len = (ULONG)count * SECTOR_SIZE;
+
+    if (rw & RW_WRITE)
+        memcpy(p, buf, len);
+    else
+        memcpy(buf, p, len);
+
+    return E_OK;
+}
+
+#endif /* CONF_WITH_RAMDISK */
@@ -0,0 +1,21 @@
+/*
+ * ramdisk.h - header for the RAM disk
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+#ifndef _RAMDISK_H
+#define _RAMDISK_H
+
+#if CONF_WITH_RAMDISK
+
+/* driver functions */
+void ramdisk_init(void);
+LONG ramdisk_ioctl(UWORD drv,UWORD ctrl,void *arg);
+LONG ramdisk_rw(WORD rw,LONG sector,WORD count,UBYTE *buf,WORD dev);
+
+#endif /* CONF_WITH_RAMDISK */
+
+#endif /* _RAMDISK_H */
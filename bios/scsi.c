@@ -353,6 +353,16 @@ LONG scsi_ioctl(WORD dev, UWORD ctrl, void *arg)
     return rc;
 }
 
+#if CONF_WITH_DMA_BOUNCE
+/*
+ * TRUE if the SCSI DMA chip can only reach ST-RAM
+ */
+BOOL scsi_needs_stram(void)
+{
+    return (has_scsi == FALCON_SCSI);
+}
+#endif
+
 /*
  * perform data transfer functions
  */
@@ -373,11 +383,15 @@ LONG scsi_rw(UWORD rw, ULONG sector, UWORD count, UBYTE *buf, WORD dev)
         /*
          * the Falcon SCSI hardware requires that the buffer be word-aligned
          * and located in ST-RAM.  if it isn't, we use an intermediate buffer:
-         * the FRB (if available) or dskbufp.
+         * the bounce pool, the FRB (if available) or dskbufp.
          */
         maxsecs_per_io = MAXSECS_PER_FSCSI_IO;
         if (IS_ODD_POINTER(buf) || !IS_STRAM_POINTER(buf))
         {
+#if CONF_WITH_DMA_BOUNCE
+            if (dmabounce)
+                return dma_bounce_rw(rw, sector, count, buf, dev, maxsecs_per_io, do_scsi_rw);
+#endif
 #if CONF_WITH_FRB
             tmp_buf = get_frb_cookie();
             if (maxsecs_per_io > FRB_SECS)
@@ -990,6 +1004,10 @@ static int handle_data_out(CMDINFO *info)
     if (info->mode & DMA_MODE)  /* doing DMA ? */
     {
         init_data_out(info);
+#if CONF_WITH_DMA_BOUNCE
+        dma_overlap_copy();     /* meanwhile, copy the other bounce half */
+        timeout = hz_200 + info->xfer_time;
+#endif
         return wait_dma_complete(timeout);
     }
 
@@ -1017,6 +1035,10 @@ static int handle_data_in(CMDINFO *info)
     if (info->mode & DMA_MODE)      /* doing DMA ? */
     {
         init_data_in(info);
+#if CONF_WITH_DMA_BOUNCE
+        dma_overlap_copy();     /* meanwhile, copy the other bounce half */
+        timeout = hz_200 + info->xfer_time;
+#endif
         ret = wait_dma_complete(timeout);
         if ((ret == 0) && (has_scsi == TT_SCSI))
             cleanup_tt_dma(info);   /* do any DMA cleanup required */
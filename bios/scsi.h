@@ -45,6 +45,9 @@ LONG scsi_ioctl(WORD dev, UWORD ctrl, void *arg);
 LONG scsi_request_sense(WORD dev, UBYTE *buffer);
 LONG scsi_rw(UWORD rw, ULONG sector, UWORD count, UBYTE *buf, WORD dev);
 LONG send_scsi_command(WORD dev, CMDINFO *info);
+#if CONF_WITH_DMA_BOUNCE
+BOOL scsi_needs_stram(void);
+#endif
 
 #endif /* CONF_WITH_SCSI */
 
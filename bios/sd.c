@@ -1,7 +1,7 @@
 /*
  * sd.c - SD/MMC card routines
  *
- * Copyright (C) 2013-2021 The EmuTOS development team
+ * Copyright (C) 2013-2024 The EmuTOS development team
  *
  * Authors:
  *  RFB   Roger Burrows
@@ -48,6 +48,7 @@
                             /* Application-specific command class */
 #define CMD55       55          /* APP_CMD: response type R1 */
 #define ACMD13      13          /* SD_STATUS: response type R2 (in SPI mode only!) */
+#define ACMD23      23          /* SET_WR_BLK_ERASE_COUNT: response type R1 */
 #define ACMD41      41          /* SD_SEND_OP_COND: response type R1 */
 #define ACMD51      51          /* SEND_SCR: response type R1 */
 
@@ -120,11 +121,27 @@ struct cardinfo {
 static struct cardinfo card;
 static UBYTE response[5];
 
+/*
+ *  multiple block sessions
+ *
+ *  during a GEMDOS call (see sd_hold()), a READ_MULTIPLE_BLOCK or
+ *  WRITE_MULTIPLE_BLOCK session is left open at the end of a transfer,
+ *  with the card still selected.  if the next transfer is in the same
+ *  direction and starts where the previous one ended, it just continues
+ *  the session, saving a command and a stop.  the session is ended
+ *  before anything else is sent to the card, and at the end of the call,
+ *  so that the card is never left in a write session for long.
+ */
+static UBYTE session_cmd;       /* CMD18, CMD25, or 0 if none open */
+static ULONG session_posn;      /* card address following the last transfer */
+static BOOL session_hold;       /* TRUE if sessions may be left open */
+
 /*
  *  function prototypes
  */
 static void sd_cardtype(struct cardinfo *info);
 static int sd_command(UBYTE cmd,ULONG argument,UBYTE crc,UBYTE resptype,UBYTE *resp);
+static int sd_end_session(void);
 static ULONG sd_calc_capacity(UBYTE *csd);
 static LONG sd_check(UWORD drv);
 static void sd_features(struct cardinfo *info);
@@ -225,6 +242,8 @@ UBYTE cardreg[16];
     if (drv)
         return EUNDEV;
 
+    sd_end_session();
+
     switch(ctrl) {
     case GET_DISKINFO:
         if (sd_special_read(CMD9,cardreg)) {    /* medium could have changed */
@@ -306,6 +325,8 @@ int i, rc;
     if (drv)
         return EUNDEV;
 
+    sd_end_session();
+
     spi_initialise();
     spi_clock_ident();
 
@@ -319,6 +340,13 @@ int i, rc;
 
     spi_cs_assert();
 
+    /*
+     *  a warm reset may have left the card in a write session, which
+     *  would ignore CMD0: end it.  the token is ignored in other states.
+     */
+    spi_send_byte(STOP_TRANSMISSION_TOKEN);
+    sd_wait_for_not_busy(SD_WRITE_TIMEOUT_TICKS);
+
     /*
      *  if CMD0 doesn't cause a switch to idle state, there's
      *  probably no card inserted, so exit with error
@@ -369,10 +397,9 @@ int i, rc;
  */
 static LONG sd_read(UWORD drv,ULONG sector,UWORD count,UBYTE *buf)
 {
-LONG i, rc, rc2;
+LONG i, rc;
 LONG posn, incr;
-
-    spi_cs_assert();
+BOOL sequential;
 
     /*
      *  handle byte/block addressing
@@ -385,33 +412,52 @@ LONG posn, incr;
         incr = SECTOR_SIZE;
     }
 
-    rc = 0L;
-
     /*
-     *  can we use multi sector reads?
+     *  unless we can continue the current read session, start a new
+     *  one for multi sector reads, and for single sector reads which
+     *  follow the previous transfer
      */
-    if ((count > 1) && (card.features&MULTIBLOCK_IO)) {
-        rc = sd_command(CMD18,posn,0,R1,response);
-        if (rc == 0L) {
-            for (i = 0; i < count; i++, buf += SECTOR_SIZE) {
-                rc = sd_receive_data(buf,SECTOR_SIZE,0);
-                if (rc)
-                    break;
+    if ((session_cmd != CMD18) || (session_posn != posn)) {
+        sequential = (session_posn == posn);
+        rc = sd_end_session();
+        if (rc)
+            return rc;
+        spi_cs_assert();
+        if (((count > 1) || (sequential && session_hold)) && (card.features&MULTIBLOCK_IO)) {
+            rc = sd_command(CMD18,posn,0,R1,response);
+            if (rc) {
+                spi_cs_unassert();
+                return rc;
             }
-            rc2 = sd_command(CMD12,0L,0,R1B,response);
-            if (rc == 0)
-                rc = rc2;
+            session_cmd = CMD18;
         }
-    } else {            /* use single sector */
-        for (i = 0; i < count; i++, posn += incr, buf += SECTOR_SIZE) {
-            rc = sd_command(CMD17,posn,0,R1,response);
-            if (rc == 0L)
-                rc = sd_receive_data(buf,SECTOR_SIZE,0);
-            if (rc)
-                break;
+    }
+
+    if (session_cmd == CMD18) {
+        for (i = 0; i < count; i++, buf += SECTOR_SIZE) {
+            rc = sd_receive_data(buf,SECTOR_SIZE,0);
+            if (rc) {
+                sd_end_session();
+                return rc;
+            }
         }
+        session_posn = posn + count * incr;
+        if (!session_hold)
+            return sd_end_session();
+        return 0L;      /* the card stays selected */
     }
 
+    /* use single sector */
+    rc = 0L;
+    for (i = 0; i < count; i++, posn += incr, buf += SECTOR_SIZE) {
+        rc = sd_command(CMD17,posn,0,R1,response);
+        if (rc == 0L)
+            rc = sd_receive_data(buf,SECTOR_SIZE,0);
+        if (rc)
+            break;
+    }
+    session_posn = posn;
+
     spi_cs_unassert();
 
     return rc;
@@ -420,15 +466,16 @@ LONG posn, incr;
 /*
  *  write one or more blocks
  *
- *  note: we don't use the pre-erase function, since
- *  it doesn't seem to improve performance
+ *  note: when an SD card write session is started for several sectors,
+ *  we tell the card how many with SET_WR_BLK_ERASE_COUNT, so that it
+ *  can pre-erase them.  this is only a hint: the session may continue
+ *  beyond them.
  */
 static LONG sd_write(UWORD drv,ULONG sector,UWORD count,UBYTE *buf)
 {
-LONG i, rc, rc2;
+LONG i, rc;
 LONG posn, incr;
-
-    spi_cs_assert();
+BOOL sequential;
 
     /*
      *  handle byte/block addressing
@@ -441,31 +488,112 @@ LONG posn, incr;
         incr = SECTOR_SIZE;
     }
 
-    rc = 0L;
-
     /*
-     *  can we use multi sector writes?
+     *  unless we can continue the current write session, start a new
+     *  one for multi sector writes, and for single sector writes which
+     *  follow the previous transfer
      */
-    if ((count > 1) && (card.features&MULTIBLOCK_IO)) {
-        rc = sd_command(CMD25,posn,0,R1,response);
-        if (rc == 0L) {
-            for (i = 0; i < count; i++, buf += SECTOR_SIZE) {
-                rc = sd_send_data(buf,SECTOR_SIZE,START_MULTI_WRITE_TOKEN);
-                if (rc)
-                    break;
+    if ((session_cmd != CMD25) || (session_posn != posn)) {
+        sequential = (session_posn == posn);
+        rc = sd_end_session();
+        if (rc)
+            return rc;
+        spi_cs_assert();
+        if (((count > 1) || (sequential && session_hold)) && (card.features&MULTIBLOCK_IO)) {
+            if ((count > 1) && (card.type == CARDTYPE_SD))
+                if (sd_command(CMD55,0L,0,R1,response) == 0)
+                    sd_command(ACMD23,count,0,R1,response);
+            rc = sd_command(CMD25,posn,0,R1,response);
+            if (rc) {
+                spi_cs_unassert();
+                return rc;
             }
-            rc2 = sd_send_data(NULL,0,STOP_TRANSMISSION_TOKEN);
-            if (rc == 0)
-                rc = rc2;
+            session_cmd = CMD25;
         }
-    } else {            /* use single sector write */
-        for (i = 0; i < count; i++, posn += incr, buf += SECTOR_SIZE) {
-            rc = sd_command(CMD24,posn,0,R1,response);
-            if (rc == 0L)
-                rc = sd_send_data(buf,SECTOR_SIZE,START_BLOCK_TOKEN);
-            if (rc)
-                break;
+    }
+
+    if (session_cmd == CMD25) {
+        for (i = 0; i < count; i++, buf += SECTOR_SIZE) {
+            rc = sd_send_data(buf,SECTOR_SIZE,START_MULTI_WRITE_TOKEN);
+            if (rc) {
+                sd_end_session();
+                return rc;
+            }
         }
+        session_posn = posn + count * incr;
+        if (!session_hold)
+            return sd_end_session();
+        return 0L;      /* the card stays selected */
+    }
+
+    /* use single sector write */
+    rc = 0L;
+    for (i = 0; i < count; i++, posn += incr, buf += SECTOR_SIZE) {
+        rc = sd_command(CMD24,posn,0,R1,response);
+        if (rc == 0L)
+            rc = sd_send_data(buf,SECTOR_SIZE,START_BLOCK_TOKEN);
+        if (rc)
+            break;
+    }
+    session_posn = posn;
+
+    spi_cs_unassert();
+
+    return rc;
+}
+
+/*
+ *  allow multiple block sessions to stay open between transfers (at the
+ *  start of a GEMDOS call), or end the current one and stop that (at the
+ *  end of the call, before a program is started or resumed, and before
+ *  shutdown)
+ *
+ *  returns an error if ending the session failed, as sd_rw() would
+ */
+LONG sd_hold(BOOL hold)
+{
+UBYTE cmd = session_cmd;
+int rc;
+
+    session_hold = hold;
+    if (hold)
+        return 0L;
+
+    rc = sd_end_session();
+    if (rc == 0)
+        return 0L;
+
+    KDEBUG(("sd_hold(): ending session %d failed, rc=%d\n",cmd,rc));
+    if (rc < 0) {               /* timeout: reinitialise on next access */
+        card.type = CARDTYPE_UNKNOWN;
+        return EDRVNR;
+    }
+
+    return (cmd == CMD25) ? EWRITF : EREADF;
+}
+
+/*
+ *  end the current multiple block session, if any, and deselect the card
+ *
+ *  returns -1  timeout
+ *          0   ok (or no session)
+ *          >0  error status from response[0]
+ */
+static int sd_end_session(void)
+{
+int rc;
+
+    switch(session_cmd) {
+    case CMD18:
+        session_cmd = 0;
+        rc = sd_command(CMD12,0L,0,R1B,response);
+        break;
+    case CMD25:
+        session_cmd = 0;
+        rc = sd_send_data(NULL,0,STOP_TRANSMISSION_TOKEN);
+        break;
+    default:
+        return 0;
     }
 
     spi_cs_unassert();
@@ -602,8 +730,7 @@ UBYTE token;
      *  transfer data
      */
     if (buf) {
-        for (i = 0; i < len; i++)
-            *buf++ = spi_recv_byte();
+        spi_recv_block(buf,len);
     } else {
         for (i = 0; i < len; i++)
             spi_recv_byte();
@@ -623,7 +750,6 @@ UBYTE token;
  */
 static int sd_send_data(UBYTE *buf,UWORD len,UBYTE token)
 {
-LONG i;
 UBYTE rtoken;
 
     spi_send_byte(token);
@@ -631,8 +757,7 @@ UBYTE rtoken;
         spi_recv_byte();    /* skip a byte before testing for busy */
     } else {
         /* send the data */
-        for (i = 0; i < len; i++)
-            spi_send_byte(*buf++);
+        spi_send_block(buf,len);
         spi_send_byte(0xff);        /* send dummy crc */
         spi_send_byte(0xff);
 
@@ -18,6 +18,7 @@
 void sd_init(void);
 LONG sd_ioctl(UWORD drv,UWORD ctrl,void *arg);
 LONG sd_rw(WORD rw,LONG sector,WORD count,UBYTE *buf,WORD dev);
+LONG sd_hold(BOOL hold);
 
 #endif /* CONF_WITH_SDMMC */
 
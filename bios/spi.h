@@ -1,7 +1,7 @@
 /*
  * spi.h - header for SPI functions used by SD/MMC driver
  *
- * Copyright (C) 2013-2019 The EmuTOS development team
+ * Copyright (C) 2013-2024 The EmuTOS development team
  *
  * Authors:
  *  RFB   Roger Burrows
@@ -21,4 +21,8 @@ void spi_initialise(void);
 UBYTE spi_recv_byte(void);
 void spi_send_byte(UBYTE input);
 
+/* same as calling spi_recv_byte()/spi_send_byte() for each byte, but faster */
+void spi_recv_block(UBYTE *buf,UWORD len);
+void spi_send_block(const UBYTE *buf,UWORD len);
+
 #endif /* _SPI_H */
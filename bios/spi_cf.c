@@ -193,3 +193,47 @@ ULONG temp;
 
     return LOBYTE(temp);
 }
+
+/*
+ *  block transfers: the loops are unrolled, and the status register
+ *  is polled directly instead of via spi_send_byte()/spi_recv_byte()
+ */
+#define SPI_XFER(out)   do {                                \
+        MCF_DSPI_DTFR = (out);                              \
+        while(!(MCF_DSPI_DSR & MCF_DSPI_DSR_TCF))           \
+            ;                                               \
+    } while(0)
+#define SPI_RECV(p)     do {                                \
+        SPI_XFER(fifo_out | 0xff);                          \
+        *(p)++ = LOBYTE(MCF_DSPI_DRFR);                     \
+        MCF_DSPI_DSR = 0xffffffffL;                         \
+    } while(0)
+#define SPI_SEND(p)     do {                                \
+        SPI_XFER(fifo_out | *(p)++);                        \
+        FORCE_READ(MCF_DSPI_DRFR);                          \
+        MCF_DSPI_DSR = 0xffffffffL;                         \
+    } while(0)
+
+void spi_recv_block(UBYTE *buf,UWORD len)
+{
+UWORD n;
+
+    for (n = len >> 3; n; n--) {
+        SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf);
+        SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf);
+    }
+    for (n = len & 7; n; n--)
+        SPI_RECV(buf);
+}
+
+void spi_send_block(const UBYTE *buf,UWORD len)
+{
+UWORD n;
+
+    for (n = len >> 3; n; n--) {
+        SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf);
+        SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf);
+    }
+    for (n = len & 7; n; n--)
+        SPI_SEND(buf);
+}
@@ -77,4 +77,41 @@ UBYTE spi_recv_byte(void)
     /* reading will stall until transmission is complete */
     return SAGA_SDCARD_DATA;
 }
+
+/*
+ *  block transfers: the loops are unrolled to minimize the overhead
+ *  between the bytes
+ */
+#define SPI_RECV(p)     do {                                \
+        SAGA_SDCARD_DATA = 0xFF;                            \
+        *(p)++ = SAGA_SDCARD_DATA;                          \
+    } while(0)
+#define SPI_SEND(p)     do {                                \
+        SAGA_SDCARD_DATA = *(p)++;                          \
+        FORCE_READ(SAGA_SDCARD_DATA);                       \
+    } while(0)
+
+void spi_recv_block(UBYTE *buf,UWORD len)
+{
+UWORD n;
+
+    for (n = len >> 3; n; n--) {
+        SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf);
+        SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf); SPI_RECV(buf);
+    }
+    for (n = len & 7; n; n--)
+        SPI_RECV(buf);
+}
+
+void spi_send_block(const UBYTE *buf,UWORD len)
+{
+UWORD n;
+
+    for (n = len >> 3; n; n--) {
+        SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf);
+        SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf); SPI_SEND(buf);
+    }
+    for (n = len & 7; n; n--)
+        SPI_SEND(buf);
+}
 #endif /* CONF_WITH_VAMPIRE_SPI */
@@ -72,6 +72,7 @@ static void ascii_lf(void);
 static void ascii_cr(void);
 
 /* handlers for the console state machine */
+static void normal_ascii(WORD);
 static void esc_ch1(WORD);
 static void get_row(WORD);
 static void get_column(WORD);
@@ -160,6 +161,33 @@ void cputc(WORD ch)
 }
 
 
+#if CONF_WITH_BATCHED_CONOUT
+/*
+ * cputs - console output of a string of printable characters
+ *
+ * same as calling cputc() for each character, but once any escape
+ * sequence in progress is complete, the rest is output in one go
+ */
+void cputs(const UBYTE *s, WORD n)
+{
+#if !CONF_SERIAL_CONSOLE
+    while ((n > 0) && con_state && (con_state != normal_ascii)) {
+        cputc(*s++);
+        n--;
+    }
+
+    if (con_state && (n > 0)) {
+        ascii_outs(s, n);
+        return;
+    }
+#endif
+
+    while (n-- > 0)
+        cputc(*s++);
+}
+#endif
+
+
 /*
  * normal_ascii - state is normal output
  */
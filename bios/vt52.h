@@ -20,5 +20,8 @@ void vt52_init(void);               /* initialize the vt52 console */
 WORD cursconf(WORD, WORD);          /* XBIOS cursor configuration */
 
 void cputc(WORD);
+#if CONF_WITH_BATCHED_CONOUT
+void cputs(const UBYTE *s, WORD n);
+#endif
 
 #endif /* VT52_H */
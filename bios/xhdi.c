@@ -228,7 +228,14 @@ static long XHMediumChanged(UWORD major, UWORD minor)
             return ret;
     }
 
+#if CONF_WITH_MEDIACH_POLICY
+    if (minor != 0)
+        return EUNDEV;
+
+    return blkdev_force_mediach(NUMFLOPPIES + major);
+#else
     return EINVFN;
+#endif
 }
 
 static long XHMiNTInfo(UWORD opcode, void *data)
@@ -438,6 +445,10 @@ static long XHReadWrite(UWORD major, UWORD minor, UWORD rw, ULONG sector,
 
     unit = NUMFLOPPIES + major;
 
+#if CONF_WITH_BLKDEV_CACHE
+    blkdev_cache_sync(unit, rw);
+#endif
+
     return disk_rw(unit, rw, sector, count, buf);
 }
 
@@ -43,6 +43,7 @@ extern LONG jmp_xbios(WORD, ...);
 #define jmp_gemdos_l(a,b)       jmp_gemdos((WORD)(a),(LONG)(b))
 #define jmp_gemdos_p(a,b)       jmp_gemdos((WORD)(a),(void*)(b))
 #define jmp_gemdos_ww(a,b,c)    jmp_gemdos((WORD)(a),(WORD)(b),(WORD)(c))
+#define jmp_gemdos_wwl(a,b,c,d) jmp_gemdos((WORD)(a),(WORD)(b),(WORD)(c),(LONG)(d))
 #define jmp_gemdos_pw(a,b,c)    jmp_gemdos((WORD)(a),(void *)(b),(WORD)(c))
 #define jmp_gemdos_wlp(a,b,c,d) jmp_gemdos((WORD)(a),(WORD)(b),(LONG)(c),(void *)(d))
 #define jmp_gemdos_wpp(a,b,c,d) jmp_gemdos((WORD)(a),(WORD)(b),(void *)(c),(void *)(d))
@@ -56,6 +57,8 @@ extern LONG jmp_xbios(WORD, ...);
 #define jmp_xbios_ww(a,b,c)     jmp_xbios((WORD)(a),(WORD)(b),(WORD)(c))
 
 #define Dsetdrv(a)          jmp_gemdos_w(0x0e,a)
+#define Fcopy(a,b,c)        jmp_gemdos_wwl(0x1c,a,b,c)
+#define Fsnextn(a,b)        jmp_gemdos_pw(0x1d,a,b)
 #define Dgetdrv()           jmp_gemdos_v(0x19)
 #define Fgetdta()           jmp_gemdos_v(0x2f)
 #define Sversion()          jmp_gemdos_v(0x30)
@@ -99,6 +102,7 @@ extern LONG jmp_xbios(WORD, ...);
 #define MAXCMDLINE      125     /* the most amount of real data allowed */
 
 #define IOBUFSIZE       16384L  /* buffer size */
+#define FCOPY_CHUNK     (256*1024L) /* amount copied per Fcopy() call */
 
 #define MAX_LINE_SIZE   200L    /* must be greater than the largest screen width */
 #define HISTORY_SIZE    10      /* number of lines of history */
@@ -148,6 +152,15 @@ typedef struct {
     char    d_fname[14];
 } DTA;
 
+typedef struct {                /* returned by Fsnextn() */
+    char    d_reserved;
+    char    d_attrib;
+    WORD    d_time;
+    WORD    d_date;
+    LONG    d_length;
+    char    d_fname[14];
+} DTAENTRY;
+
 /* Type of function run by execute() */
 typedef LONG FUNC(WORD argc,char **argv);
 
@@ -161,6 +174,7 @@ typedef LONG FUNC(WORD argc,char **argv);
 /*
  *  manifest constants
  */
+#define EINVFN          -32
 #define EFILNF          -33
 #define EPTHNF          -34
 #define ENHNDL          -35
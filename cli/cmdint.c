@@ -40,6 +40,8 @@ PRIVATE void outputnl(const char *s);
 PRIVATE LONG outputbuf(const char *s,LONG len,WORD paging);
 PRIVATE LONG output_files(WORD argc,char **argv,WORD paging);
 PRIVATE void padname(char *buf,const char *name);
+PRIVATE LONG search_first(char *filespec,WORD attr);
+PRIVATE LONG search_next(void);
 PRIVATE void show_line(const char *title,ULONG n);
 PRIVATE WORD user_break(void);
 PRIVATE WORD user_input(WORD c);
@@ -385,7 +387,7 @@ WORD detail = 0;
         output(_("Listing of "));
         outputnl(filespec);
     }
-    for (rc = Fsfirst(filespec,0x17), n = 0; rc == 0; rc = Fsnext()) {
+    for (rc = search_first(filespec,0x17), n = 0; rc == 0; rc = search_next()) {
         if (constat())
             if (user_input(-1))
                 return USER_BREAK;
@@ -787,7 +789,7 @@ PRIVATE LONG copy_move(WORD argc,char **argv,WORD delete)
 {
 char inname[MAXPATHLEN], outname[MAXPATHLEN], fullname[MAXPATHLEN];
 char *inptr, *outptr;
-WORD in, out, output_is_dir = 0;
+WORD in, out, output_is_dir = 0, fcopy;
 char *iobuf;
 LONG bufsize, n, rc;
 
@@ -872,7 +874,7 @@ LONG bufsize, n, rc;
         }
         out = LOWORD(rc);
 
-        do {
+        for (rc = 0L, fcopy = 1; rc >= 0L; ) {
             /* allow user to interrupt during file copy/move */
             if (constat()) {
                 if (user_break()) {
@@ -880,15 +882,28 @@ LONG bufsize, n, rc;
                     break;
                 }
             }
+            /*
+             * let GEMDOS copy the file if it can (EmuTOS only), a chunk
+             * at a time.  once it copies less than a chunk, we copy
+             * anything left over ourselves, and detect a full disk.
+             */
+            if (fcopy) {
+                rc = Fcopy(in,out,FCOPY_CHUNK);
+                if ((rc == EINVFN) || (rc == ENSMEM))   /* not supported, no memory */
+                    rc = 0L;
+                if (rc != FCOPY_CHUNK)
+                    fcopy = 0;
+                continue;
+            }
             n = rc = Fread(in,bufsize,iobuf);
-            if (rc < 0L)
+            if (rc <= 0L)       /* error or end of file */
                 break;
             rc = Fwrite(out,n,iobuf);
             if (rc < 0L)
                 break;
             if (rc != n)
                 rc = DISK_FULL;
-        } while(rc > 0L);
+        }
         Fclose(in);
         Fclose(out);
 
@@ -1065,6 +1080,47 @@ WORD drive;
     strcpy(p,"\\*.*");
 }
 
+/*
+ *  search_first()/search_next() work like Fsfirst()/Fsnext(), but get
+ *  directory entries in batches via Fsnextn() when GEMDOS provides it
+ */
+#define SEARCHBATCH 16
+
+LOCAL DTAENTRY searchbuf[SEARCHBATCH];
+LOCAL WORD searchnext, searchcount, searchnobatch;
+
+PRIVATE LONG search_first(char *filespec,WORD attr)
+{
+    searchnext = searchcount = 0;
+    searchnobatch = 0;
+
+    return Fsfirst(filespec,attr);
+}
+
+PRIVATE LONG search_next(void)
+{
+LONG rc;
+
+    if ((searchnext >= searchcount) && !searchnobatch) {
+        rc = Fsnextn(searchbuf,SEARCHBATCH);
+        if (rc == EINVFN)       /* not EmuTOS, or GEMDOS is hooked */
+            searchnobatch = 1;
+        else if (rc < 0L)
+            return rc;
+        else {
+            searchnext = 0;
+            searchcount = LOWORD(rc);
+        }
+    }
+
+    if (searchnext < searchcount) {
+        memcpy(&dta->d_attrib,&searchbuf[searchnext++].d_attrib,sizeof(DTAENTRY)-1);
+        return 0L;
+    }
+
+    return Fsnext();
+}
+
 PRIVATE void padname(char *buf,const char *name)
 {
 WORD i;
@@ -448,7 +448,19 @@ static WORD d_dofcopy(char *psrc_file, char *pdst_file, WORD time, WORD date, WO
      * perform copy
      */
     rc = TRUE;
-    while(1)
+#if CONF_WITH_FCOPY
+    /*
+     * let GEMDOS copy the file.  the loop below then copies anything
+     * left over, and detects a full disk.
+     */
+    readlen = 0L;       /* if this fails, blame the destination */
+    error = dos_copy(srcfh, dstfh, -1L);
+    if ((error == EINVFN) || (error == ENSMEM)) /* e.g. GEMDOS drive emulation */
+        error = 0L;         /* so copy it ourselves */
+#else
+    error = 0L;
+#endif
+    while(error >= 0L)
     {
         error = readlen = dos_read(srcfh, copylen, copybuf);
         if (error == 0L)    /* end of file */
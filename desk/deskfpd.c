@@ -256,13 +256,13 @@ WORD pn_active(PNODE *pn, BOOL include_folders)
     if (include_folders)                /* match all folders? */
         del_fname(search);              /* yes - change search filespec to *.* */
     match = filename_start(pn->p_spec); /* the match filespec is always unaltered */
-    for (ret = dos_sfirst(search, pn->p_attr), count = 0; (ret == 0) && (count < maxcount); ret = dos_snext())
+    for (ret = dir_sfirst(search, pn->p_attr), count = 0; (ret == 0) && (count < maxcount); ret = dir_snext(&G.g_wdta))
     {
         if (G.g_wdta.d_attrib != FA_SUBDIR) /* skip *files* that don't match */
             if (!wildcmp(match, G.g_wdta.d_fname))
                 continue;
 #else
-    for (ret = dos_sfirst(pn->p_spec,pn->p_attr), count = 0; (ret == 0) && (count < maxcount); ret = dos_snext())
+    for (ret = dir_sfirst(pn->p_spec,pn->p_attr), count = 0; (ret == 0) && (count < maxcount); ret = dir_snext(&G.g_wdta))
     {
 #endif
         if (G.g_wdta.d_fname[0] == '.') /* skip "." & ".." entries */
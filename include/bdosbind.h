@@ -29,6 +29,7 @@ extern long trap1_pexec(short mode, const char *path, const char *tail, const ch
 #endif
 #define Dgetdrv() trap1(0x19)
 #define Fsetdta(buf) trap1(0x1a, buf)
+#define Fcopy(hsrc,hdst,len) trap1(0x1c, hsrc, hdst, len)
 #define Fgetdta() trap1(0x2f)
 #define Dcreate(path) trap1(0x39, path)
 #define Dfree(buf,driveno) trap1(0x36, buf, driveno)
@@ -50,6 +51,8 @@ extern long trap1_pexec(short mode, const char *path, const char *tail, const ch
 #define Pexec(mode,name,cmdline,env) trap1_pexec(mode, name, cmdline, env)
 #define Fsfirst(filename,attr) trap1(0x4e, filename, attr)
 #define Fsnext() trap1(0x4f)
+#define Fsnextn(buf,count) trap1(0x1d, buf, count)
+#define Pflush() trap1(0x1e)
 #define Frename(oldname,newname) trap1(0x56, 0, oldname, newname)
 #define Fdatime(timeptr,handle,wflag) trap1(0x57, timeptr, handle, wflag)
 
@@ -54,6 +54,59 @@ typedef struct
     char    d_fname[14];        /* name */
 } DTA;
 
+/*
+ *  DTAENTRY - one of the entries returned by Fsnextn() (EmuTOS extension).
+ *  Starting at d_attrib, the layout is the same as the public part of a DTA.
+ */
+typedef struct
+{
+    char    d_reserved;         /* padding */
+    char    d_attrib;           /* attributes */
+    UWORD   d_time;             /* packed time */
+    UWORD   d_date;             /* packed date */
+    LONG    d_length;           /* size */
+    char    d_fname[14];        /* name */
+} DTAENTRY;
+
+/*
+ *  BDOSSTATS - GEMDOS statistics, kept if EmuTOS is built with
+ *  CONF_WITH_BDOS_STATS.  The BDST cookie points to this structure.
+ *  Times are in 200Hz ticks.  dump() and reset() must be called in
+ *  supervisor mode.
+ */
+#define BDOS_STATS_NFUNCS   0x58    /* GEMDOS functions 0x00-0x57 */
+#define BDOS_STATS_NHIST    8       /* histogram buckets per function */
+
+typedef struct
+{
+    ULONG   calls;              /* number of calls */
+    ULONG   ticks;              /* total time of calls that returned */
+    ULONG   maxticks;           /* longest call */
+    ULONG   hist[BDOS_STATS_NHIST]; /* calls taking 0, 1, 2-3, 4-7, ... */
+} BDOSFNSTATS;                      /*  32-63, and 64+ ticks            */
+
+typedef struct
+{
+    UWORD   version;            /* structure version (currently 2) */
+    UWORD   nfuncs;             /* number of elements in fn[] */
+    void    (*dump)(void);      /* print statistics via kprintf() */
+    void    (*reset)(void);     /* clear statistics */
+    ULONG   start;              /* _hz_200 when statistics were cleared */
+    ULONG   cachehits;          /* records found in the buffer cache */
+    ULONG   cachemisses;        /* records read into the buffer cache */
+    ULONG   cacheflushes;       /* dirty buffers written */
+    ULONG   readaheads;         /* records read ahead into the cache */
+    ULONG   directrecs;         /* records transferred bypassing the cache */
+    ULONG   devreads;           /* Rwabs() read calls */
+    ULONG   devwrites;          /* Rwabs() write calls */
+    ULONG   recsread;           /* records read by Rwabs() */
+    ULONG   recswritten;        /* records written by Rwabs() */
+    ULONG   dndhits;            /* path elements found in the DND tree */
+    ULONG   dndmisses;          /* path elements looked up on the media */
+    ULONG   dndevictions;       /* DNDs freed to make room in the pool */
+    BDOSFNSTATS fn[BDOS_STATS_NFUNCS];
+} BDOSSTATS;
+
 /*
  *  PD - Process Descriptor (a.k.a. BASEPAGE)
  */
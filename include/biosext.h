@@ -67,6 +67,35 @@ void panic(const char *fmt, ...) PRINTF_STYLE NORETURN;
 /* halt the machine */
 void halt(void) NORETURN;
 
+#if CONF_WITH_BATCHED_CONOUT
+/* output printable characters to the console, if not redirected */
+LONG con_outs(const UBYTE *s, WORD n);
+#endif
+
+#if CONF_WITH_MEDIACH_POLICY
+/* TRUE if GEMDOS must call Mediach() before trusting its cached records */
+BOOL blkdev_mcneeded(WORD dev);
+#endif
+
+/*
+ * TRUE if the BIOS may hold back disk writes (or keep SD/MMC transfer
+ * sessions open) during GEMDOS calls
+ */
+#define BLKDEV_HOLDS_WRITES ((CONF_WITH_BLKDEV_CACHE && CONF_BLKDEV_CACHE_WRITEBEHIND) \
+                             || CONF_WITH_DISK_MERGE || CONF_WITH_SDMMC)
+
+#if BLKDEV_HOLDS_WRITES
+/* start holding back disk writes, at the start of a GEMDOS call */
+void blkdev_hold(void);
+/* write them, at the end of the call; returns the first write error, or 0 */
+LONG blkdev_release(void);
+#endif
+
+#if CONF_WITH_DMA_BOUNCE
+/* Mxalloc() mode for disk buffers: MX_STRAM if some DMA only reaches ST-RAM */
+WORD blkdev_mxalloc_mode(void);
+#endif
+
 #if CONF_WITH_SHUTDOWN
 BOOL can_shutdown(void);
 #endif
@@ -388,6 +388,63 @@
 # ifndef NUM_VDI_HANDLES
 #  define NUM_VDI_HANDLES 64
 # endif
+# ifndef CONF_WITH_BDOS_CACHE
+#  define CONF_WITH_BDOS_CACHE 0
+# endif
+# ifndef CONF_WITH_FAT_WRITEBACK
+#  define CONF_WITH_FAT_WRITEBACK 0
+# endif
+# ifndef CONF_WITH_EXTENT_MAP
+#  define CONF_WITH_EXTENT_MAP 0
+# endif
+# ifndef CONF_WITH_FREE_BITMAP
+#  define CONF_WITH_FREE_BITMAP 0
+# endif
+# ifndef CONF_WITH_PREALLOC
+#  define CONF_WITH_PREALLOC 0
+# endif
+# ifndef CONF_WITH_DIRINDEX
+#  define CONF_WITH_DIRINDEX 0
+# endif
+# ifndef CONF_WITH_READAHEAD
+#  define CONF_WITH_READAHEAD 0
+# endif
+# ifndef CONF_WITH_FCOPY
+#  define CONF_WITH_FCOPY 0
+# endif
+# ifndef CONF_WITH_FSNEXTN
+#  define CONF_WITH_FSNEXTN 0
+# endif
+# ifndef CONF_WITH_MALLOC_CLASSES
+#  define CONF_WITH_MALLOC_CLASSES 0
+# endif
+# ifndef CONF_WITH_OSMEM_GROW
+#  define CONF_WITH_OSMEM_GROW 0
+# endif
+# ifndef CONF_WITH_PGMCACHE
+#  define CONF_WITH_PGMCACHE 0
+# endif
+# ifndef CONF_WITH_BATCHED_CONOUT
+#  define CONF_WITH_BATCHED_CONOUT 0
+# endif
+# ifndef CONF_WITH_MEDIACH_POLICY
+#  define CONF_WITH_MEDIACH_POLICY 0
+# endif
+# ifndef CONF_WITH_BLKDEV_CACHE
+#  define CONF_WITH_BLKDEV_CACHE 0
+# endif
+# ifndef CONF_WITH_RAMDISK
+#  define CONF_WITH_RAMDISK 0
+# endif
+# ifndef CONF_WITH_FLOPPY_TRACK_CACHE
+#  define CONF_WITH_FLOPPY_TRACK_CACHE 0
+# endif
+# ifndef CONF_WITH_DMA_BOUNCE
+#  define CONF_WITH_DMA_BOUNCE 0
+# endif
+# ifndef CONF_WITH_DISK_MERGE
+#  define CONF_WITH_DISK_MERGE 0
+# endif
 #endif
 
 /*
@@ -442,6 +499,63 @@
 # ifndef MAX_VERTICES
 #  define MAX_VERTICES 512
 # endif
+# ifndef CONF_WITH_BDOS_CACHE
+#  define CONF_WITH_BDOS_CACHE 0
+# endif
+# ifndef CONF_WITH_FAT_WRITEBACK
+#  define CONF_WITH_FAT_WRITEBACK 0
+# endif
+# ifndef CONF_WITH_EXTENT_MAP
+#  define CONF_WITH_EXTENT_MAP 0
+# endif
+# ifndef CONF_WITH_FREE_BITMAP
+#  define CONF_WITH_FREE_BITMAP 0
+# endif
+# ifndef CONF_WITH_PREALLOC
+#  define CONF_WITH_PREALLOC 0
+# endif
+# ifndef CONF_WITH_DIRINDEX
+#  define CONF_WITH_DIRINDEX 0
+# endif
+# ifndef CONF_WITH_READAHEAD
+#  define CONF_WITH_READAHEAD 0
+# endif
+# ifndef CONF_WITH_FCOPY
+#  define CONF_WITH_FCOPY 0
+# endif
+# ifndef CONF_WITH_FSNEXTN
+#  define CONF_WITH_FSNEXTN 0
+# endif
+# ifndef CONF_WITH_MALLOC_CLASSES
+#  define CONF_WITH_MALLOC_CLASSES 0
+# endif
+# ifndef CONF_WITH_OSMEM_GROW
+#  define CONF_WITH_OSMEM_GROW 0
+# endif
+# ifndef CONF_WITH_PGMCACHE
+#  define CONF_WITH_PGMCACHE 0
+# endif
+# ifndef CONF_WITH_BATCHED_CONOUT
+#  define CONF_WITH_BATCHED_CONOUT 0
+# endif
+# ifndef CONF_WITH_MEDIACH_POLICY
+#  define CONF_WITH_MEDIACH_POLICY 0
+# endif
+# ifndef CONF_WITH_BLKDEV_CACHE
+#  define CONF_WITH_BLKDEV_CACHE 0
+# endif
+# ifndef CONF_WITH_RAMDISK
+#  define CONF_WITH_RAMDISK 0
+# endif
+# ifndef CONF_WITH_FLOPPY_TRACK_CACHE
+#  define CONF_WITH_FLOPPY_TRACK_CACHE 0
+# endif
+# ifndef CONF_WITH_DMA_BOUNCE
+#  define CONF_WITH_DMA_BOUNCE 0
+# endif
+# ifndef CONF_WITH_DISK_MERGE
+#  define CONF_WITH_DISK_MERGE 0
+# endif
 #endif
 
 /*
@@ -548,6 +662,63 @@
 # ifndef NUM_VDI_HANDLES
 #  define NUM_VDI_HANDLES 64
 # endif
+# ifndef CONF_WITH_BDOS_CACHE
+#  define CONF_WITH_BDOS_CACHE 0
+# endif
+# ifndef CONF_WITH_FAT_WRITEBACK
+#  define CONF_WITH_FAT_WRITEBACK 0
+# endif
+# ifndef CONF_WITH_EXTENT_MAP
+#  define CONF_WITH_EXTENT_MAP 0
+# endif
+# ifndef CONF_WITH_FREE_BITMAP
+#  define CONF_WITH_FREE_BITMAP 0
+# endif
+# ifndef CONF_WITH_PREALLOC
+#  define CONF_WITH_PREALLOC 0
+# endif
+# ifndef CONF_WITH_DIRINDEX
+#  define CONF_WITH_DIRINDEX 0
+# endif
+# ifndef CONF_WITH_READAHEAD
+#  define CONF_WITH_READAHEAD 0
+# endif
+# ifndef CONF_WITH_FCOPY
+#  define CONF_WITH_FCOPY 0
+# endif
+# ifndef CONF_WITH_FSNEXTN
+#  define CONF_WITH_FSNEXTN 0
+# endif
+# ifndef CONF_WITH_MALLOC_CLASSES
+#  define CONF_WITH_MALLOC_CLASSES 0
+# endif
+# ifndef CONF_WITH_OSMEM_GROW
+#  define CONF_WITH_OSMEM_GROW 0
+# endif
+# ifndef CONF_WITH_PGMCACHE
+#  define CONF_WITH_PGMCACHE 0
+# endif
+# ifndef CONF_WITH_BATCHED_CONOUT
+#  define CONF_WITH_BATCHED_CONOUT 0
+# endif
+# ifndef CONF_WITH_MEDIACH_POLICY
+#  define CONF_WITH_MEDIACH_POLICY 0
+# endif
+# ifndef CONF_WITH_BLKDEV_CACHE
+#  define CONF_WITH_BLKDEV_CACHE 0
+# endif
+# ifndef CONF_WITH_RAMDISK
+#  define CONF_WITH_RAMDISK 0
+# endif
+# ifndef CONF_WITH_FLOPPY_TRACK_CACHE
+#  define CONF_WITH_FLOPPY_TRACK_CACHE 0
+# endif
+# ifndef CONF_WITH_DMA_BOUNCE
+#  define CONF_WITH_DMA_BOUNCE 0
+# endif
+# ifndef CONF_WITH_DISK_MERGE
+#  define CONF_WITH_DISK_MERGE 0
+# endif
 #endif
 
 /*
@@ -1596,6 +1767,311 @@
 # define CONF_LOGSEC_SIZE 512
 #endif
 
+/*
+ * Set CONF_WITH_BDOS_CACHE to 1 to replace the two sector buffers per
+ * BDOS buffer list by a larger cache, indexed by a hash table and using
+ * LRU replacement.  The number of buffers is derived from the amount of
+ * memory available at boot time; more buffers are added in alt-RAM if
+ * it is available.
+ *
+ * CONF_BDOS_CACHE_STRAM_SIZE and CONF_BDOS_CACHE_ALTRAM_SIZE specify the
+ * maximum number of bytes used by the cache in ST-RAM and alt-RAM
+ * respectively.
+ */
+#ifndef CONF_WITH_BDOS_CACHE
+# define CONF_WITH_BDOS_CACHE 1
+#endif
+#ifndef CONF_BDOS_CACHE_STRAM_SIZE
+# define CONF_BDOS_CACHE_STRAM_SIZE (32*1024L)
+#endif
+#ifndef CONF_BDOS_CACHE_ALTRAM_SIZE
+# define CONF_BDOS_CACHE_ALTRAM_SIZE (256*1024L)
+#endif
+
+/*
+ * Set CONF_WITH_FAT_WRITEBACK to 1 to defer writing of modified FAT
+ * sectors.  Dirty FAT sectors are then written out together, in
+ * ascending order and merged into multi-sector writes, first to one
+ * FAT copy and then to the other.  This happens when a file is closed,
+ * on Dfree(), when removable media is checked for a change, when a
+ * dirty FAT buffer must be reused, and at the latest after
+ * CONF_FAT_WRITEBACK_SECS seconds.
+ *
+ * CONF_FAT_WRITEBACK_RUNSIZE is the size in bytes of the buffer used
+ * to merge consecutive sectors into a single write.
+ */
+#ifndef CONF_WITH_FAT_WRITEBACK
+# define CONF_WITH_FAT_WRITEBACK 1
+#endif
+#ifndef CONF_FAT_WRITEBACK_SECS
+# define CONF_FAT_WRITEBACK_SECS 2
+#endif
+#ifndef CONF_FAT_WRITEBACK_RUNSIZE
+# define CONF_FAT_WRITEBACK_RUNSIZE 4096
+#endif
+
+/*
+ * Set CONF_WITH_EXTENT_MAP to 1 to remember the cluster chains of a few
+ * recently-accessed files as lists of contiguous runs.  This avoids
+ * walking the FAT from the start of the file on backward seeks, and
+ * looking up the FAT for each cluster on subsequent sequential access.
+ */
+#ifndef CONF_WITH_EXTENT_MAP
+# define CONF_WITH_EXTENT_MAP 1
+#endif
+
+/*
+ * Set CONF_WITH_FREE_BITMAP to 1 to keep a bitmap of free clusters for
+ * each drive.  It is built from the FAT when first needed, and makes
+ * cluster allocation and Dfree() much faster.  A bitmap requires 1 byte
+ * per 8 clusters, i.e. up to 8 KB per drive.  The bitmaps are taken from
+ * CONF_FREE_BITMAP_STRAM_SIZE bytes of ST-RAM reserved at boot (enough
+ * for a drive of up to about 32000 clusters, or several smaller ones),
+ * then from Alt-RAM.  A drive whose bitmap fits in neither has no bitmap (and no
+ * preallocation).
+ */
+#ifndef CONF_WITH_FREE_BITMAP
+# define CONF_WITH_FREE_BITMAP 1
+#endif
+#ifndef CONF_FREE_BITMAP_STRAM_SIZE
+# define CONF_FREE_BITMAP_STRAM_SIZE 4096
+#endif
+
+/*
+ * Set CONF_WITH_PREALLOC to 1 to reserve a run of contiguous clusters
+ * when a file is extended, so that files written in several parts, or
+ * while other files are being written, are not fragmented.  The run is
+ * sized to the write (or Fcopy()) which needs it, and searched for after
+ * the file's last cluster; unused clusters are released when the file
+ * is closed.  This requires CONF_WITH_FREE_BITMAP.
+ */
+#ifndef CONF_WITH_PREALLOC
+# define CONF_WITH_PREALLOC 1
+#endif
+
+/*
+ * Set CONF_WITH_DIRINDEX to 1 to keep a hashed index of the names in
+ * large directories, so that looking up a name, or a free slot when
+ * creating a file, does not have to read through the whole directory.
+ * An index is built when a directory scan passes CONF_DIRINDEX_MIN
+ * entries; it uses 8 bytes per directory entry, taken from
+ * CONF_DIRINDEX_STRAM_SIZE bytes of ST-RAM reserved at boot, then from
+ * Alt-RAM, and is given back when DNDs are scavenged.  A directory whose
+ * index fits in neither is not indexed.
+ */
+#ifndef CONF_WITH_DIRINDEX
+# define CONF_WITH_DIRINDEX 1
+#endif
+#ifndef CONF_DIRINDEX_STRAM_SIZE
+# define CONF_DIRINDEX_STRAM_SIZE 4096
+#endif
+#ifndef CONF_DIRINDEX_MIN
+# define CONF_DIRINDEX_MIN 128
+#endif
+
+/*
+ * Set CONF_WITH_READAHEAD to 1 to detect files which are read
+ * sequentially in pieces smaller than a sector, and to read the
+ * following sectors of the file into the cache with a single
+ * multi-sector read.  The number of sectors read ahead starts at 2 and
+ * doubles up to CONF_READAHEAD_SIZE bytes, within contiguous clusters.
+ * This requires CONF_WITH_BDOS_CACHE.
+ */
+#ifndef CONF_WITH_READAHEAD
+# define CONF_WITH_READAHEAD 1
+#endif
+#ifndef CONF_READAHEAD_SIZE
+# define CONF_READAHEAD_SIZE 8192
+#endif
+
+/*
+ * Set CONF_WITH_FCOPY to 1 to provide Fcopy() (GEMDOS function 0x1C,
+ * an EmuTOS extension), which copies data from one open file to another
+ * inside GEMDOS.  The destination clusters are reserved in advance, and
+ * the data is transferred in blocks of up to CONF_FCOPY_BUFSIZE bytes.
+ * The desktop and EmuCON use it to copy files.
+ */
+#ifndef CONF_WITH_FCOPY
+# define CONF_WITH_FCOPY 1
+#endif
+#ifndef CONF_FCOPY_BUFSIZE
+# define CONF_FCOPY_BUFSIZE (64*1024L)
+#endif
+
+/*
+ * Set CONF_WITH_FSNEXTN to 1 to provide Fsnextn() (GEMDOS function 0x1D,
+ * an EmuTOS extension), which returns many Fsnext() results in a single
+ * call.  The desktop, the file selector and EmuCON use it to read
+ * directories.
+ */
+#ifndef CONF_WITH_FSNEXTN
+# define CONF_WITH_FSNEXTN 1
+#endif
+
+/*
+ * Set CONF_WITH_PGMCACHE to 1 to keep copies of recently loaded programs
+ * in Alt-RAM (up to CONF_PGMCACHE_SIZE bytes in total), so that Pexec()
+ * can load them again without reading the file.  A copy is only used if
+ * the file's date, time and length are unchanged.  Pflush() (GEMDOS
+ * function 0x1E, an EmuTOS extension) empties the cache.
+ */
+#ifndef CONF_WITH_PGMCACHE
+# define CONF_WITH_PGMCACHE 1
+#endif
+#ifndef CONF_PGMCACHE_SIZE
+# define CONF_PGMCACHE_SIZE (256*1024L)
+#endif
+
+/*
+ * Set CONF_WITH_BATCHED_CONOUT to 1 to let GEMDOS pass runs of printable
+ * characters written to the console (via Cconws() or Fwrite() to CON:)
+ * directly to the BIOS screen driver, which renders them in one go.
+ * This is not done if the BIOS trap or the console output vector has
+ * been intercepted.
+ */
+#ifndef CONF_WITH_BATCHED_CONOUT
+# define CONF_WITH_BATCHED_CONOUT 1
+#endif
+
+/*
+ * Set CONF_WITH_MEDIACH_POLICY to 1 to let GEMDOS skip the Mediach()
+ * call that validates a cached record before using it, when the BIOS
+ * knows the answer: media in non-removable units never change unless
+ * this is forced (via XHMediumChanged() or by writing logical sector 0
+ * with Rwabs()), and removable media are only checked again after
+ * CONF_MEDIACH_WINDOW ticks of the 200 Hz timer.  Mediach() is always
+ * called if hdv_mediach or the BIOS trap has been intercepted.
+ */
+#ifndef CONF_WITH_MEDIACH_POLICY
+# define CONF_WITH_MEDIACH_POLICY 1
+#endif
+#ifndef CONF_MEDIACH_WINDOW
+# define CONF_MEDIACH_WINDOW 40
+#endif
+
+/*
+ * Set CONF_WITH_BLKDEV_CACHE to 1 to keep recently used physical sectors
+ * of the hard disk units in a BIOS cache, below Rwabs() (floppies have
+ * their own track buffer).  This speeds up programs which bypass the
+ * GEMDOS buffers, such as disk utilities.  The cache
+ * uses up to CONF_BLKDEV_CACHE_SIZE bytes of Alt-RAM, or a quarter of
+ * that in ST-RAM if there is no Alt-RAM.  Writes go straight through to
+ * the media, unless CONF_BLKDEV_CACHE_WRITEBEHIND is set to 1: then
+ * writes to non-removable units during a GEMDOS call are collected, and
+ * written in sector order at the end of the call, or earlier when the
+ * cache is full or after a short delay.
+ */
+#ifndef CONF_WITH_BLKDEV_CACHE
+# define CONF_WITH_BLKDEV_CACHE 1
+#endif
+#ifndef CONF_BLKDEV_CACHE_SIZE
+# define CONF_BLKDEV_CACHE_SIZE (64*1024L)
+#endif
+#ifndef CONF_BLKDEV_CACHE_WRITEBEHIND
+# define CONF_BLKDEV_CACHE_WRITEBEHIND 0
+#endif
+
+/*
+ * Set CONF_WITH_FLOPPY_TRACK_CACHE to 1 to read the whole track/side
+ * when part of it is read from a floppy, and serve the following reads
+ * of that track/side from memory (a few KB of ST-RAM), for a short time.
+ */
+#ifndef CONF_WITH_FLOPPY_TRACK_CACHE
+# define CONF_WITH_FLOPPY_TRACK_CACHE CONF_WITH_FDC
+#endif
+
+/*
+ * Set CONF_WITH_RAMDISK to 1 to provide a RAM disk as an additional
+ * non-removable unit, handled like a hard disk by the BIOS and XHDI.
+ * It is allocated in Alt-RAM if available, otherwise in ST-RAM, and is
+ * formatted on creation.  Its size in bytes is CONF_RAMDISK_SIZE (0 means
+ * no RAM disk), unless overridden by NVRAM byte NVRAM_RAMDISK (see
+ * bios/ramdisk.c) or, for EMUTOS.PRG, by a size in KB on its command
+ * line.  If CONF_RAMDISK_KEEP is set to 1, the contents survive a warm
+ * reset.
+ */
+#ifndef CONF_WITH_RAMDISK
+# define CONF_WITH_RAMDISK 1
+#endif
+#ifndef CONF_RAMDISK_SIZE
+# define CONF_RAMDISK_SIZE 0L
+#endif
+#ifndef CONF_RAMDISK_KEEP
+# define CONF_RAMDISK_KEEP 0
+#endif
+
+/*
+ * Set CONF_WITH_DMA_BOUNCE to 1 to allocate a bounce pool in ST-RAM for
+ * the ACSI and Falcon SCSI transfers to or from buffers which their DMA
+ * chips cannot reach (Alt-RAM).  Its size is a fraction of the free
+ * ST-RAM, up to CONF_DMA_BOUNCE_SIZE bytes.  It is split in two halves,
+ * so that copying one chunk overlaps the DMA transfer of the next one.
+ * When such hard disks are present, GEMDOS also prefers ST-RAM for the
+ * cache buffers that it would otherwise allocate in Alt-RAM.
+ */
+#ifndef CONF_WITH_DMA_BOUNCE
+# define CONF_WITH_DMA_BOUNCE (CONF_WITH_ALT_RAM && (CONF_WITH_ACSI || CONF_WITH_SCSI))
+#endif
+#ifndef CONF_DMA_BOUNCE_SIZE
+# define CONF_DMA_BOUNCE_SIZE (128*1024L)
+#endif
+
+/*
+ * Set CONF_WITH_DISK_MERGE to 1 to merge the writes to non-removable hard
+ * disk units which continue each other during a GEMDOS call: they are
+ * collected in a buffer of CONF_DISK_MERGE_SIZE bytes of ST-RAM, and sent
+ * to the hard disk driver as a single command when the run ends, at the
+ * latest at the end of the GEMDOS call, and always before a program is
+ * started or resumed, so nothing stays in the buffer while user code
+ * runs.  This saves the per-command overhead, which is several
+ * milliseconds on ACSI and SCSI.
+ */
+#ifndef CONF_WITH_DISK_MERGE
+# define CONF_WITH_DISK_MERGE (CONF_WITH_ACSI || CONF_WITH_SCSI || CONF_WITH_IDE || CONF_WITH_SDMMC)
+#endif
+#ifndef CONF_DISK_MERGE_SIZE
+# define CONF_DISK_MERGE_SIZE (16*1024L)
+#endif
+
+/*
+ * Set CONF_WITH_BDOS_STATS to 1 to keep GEMDOS statistics: the number of
+ * calls and their duration for each GEMDOS function, and counters for
+ * the buffer cache and disk I/O.  The BDST cookie points to them (see
+ * BDOSSTATS in bdosdefs.h), and tools/bdosstat.c displays them.  This is
+ * for performance analysis only, so it is disabled by default.
+ */
+#ifndef CONF_WITH_BDOS_STATS
+# define CONF_WITH_BDOS_STATS 0
+#endif
+
+/*
+ * Set CONF_WITH_MALLOC_CLASSES to 1 to index the free memory blocks of
+ * the ST-RAM and Alt-RAM pools by size.  Malloc() then allocates from
+ * the smallest free block that is large enough (best fit) rather than
+ * from the first one, without searching the whole free list, and
+ * Malloc(-1) does not need to search at all.  This makes each MD bigger,
+ * so the OS pool is made bigger too.
+ */
+#ifndef CONF_WITH_MALLOC_CLASSES
+# define CONF_WITH_MALLOC_CLASSES 1
+#endif
+
+/*
+ * Set CONF_WITH_OSMEM_GROW to 1 to let the OS pool (used for DNDs, OFDs,
+ * DMDs and MDs) grow on demand, by allocating chunks from Alt-RAM that
+ * are never given back.  ST-RAM is not used, since the chunks would be
+ * permanent holes in the memory available to programs; without Alt-RAM
+ * the pool keeps its fixed size.  The directory nodes are then only
+ * recycled when this fails, so many more directories stay cached.
+ * CONF_OSMEM_GROW_MAX is the maximum amount of memory (in bytes) added.
+ */
+#ifndef CONF_WITH_OSMEM_GROW
+# define CONF_WITH_OSMEM_GROW 1
+#endif
+#ifndef CONF_OSMEM_GROW_MAX
+# define CONF_OSMEM_GROW_MAX (128*1024L)
+#endif
+
 
 
 /****************************************************
@@ -2083,6 +2559,30 @@
 # if CONF_WITH_TTRAM
 #  error CONF_WITH_TTRAM requires CONF_WITH_ALT_RAM.
 # endif
+# if CONF_WITH_PGMCACHE
+#  error CONF_WITH_PGMCACHE requires CONF_WITH_ALT_RAM.
+# endif
+# if CONF_WITH_DMA_BOUNCE
+#  error CONF_WITH_DMA_BOUNCE requires CONF_WITH_ALT_RAM.
+# endif
+#endif
+
+#if !CONF_WITH_BLKDEV_CACHE
+# if CONF_BLKDEV_CACHE_WRITEBEHIND
+#  error CONF_BLKDEV_CACHE_WRITEBEHIND requires CONF_WITH_BLKDEV_CACHE.
+# endif
+#endif
+
+#if !CONF_WITH_FDC
+# if CONF_WITH_FLOPPY_TRACK_CACHE
+#  error CONF_WITH_FLOPPY_TRACK_CACHE requires CONF_WITH_FDC.
+# endif
+#endif
+
+#if !CONF_WITH_RAMDISK
+# if CONF_RAMDISK_KEEP
+#  error CONF_RAMDISK_KEEP requires CONF_WITH_RAMDISK.
+# endif
 #endif
 
 #ifndef STATIC_ALT_RAM_ADDRESS
@@ -2094,6 +2594,18 @@
 # endif
 #endif
 
+#if !CONF_WITH_BDOS_CACHE
+# if CONF_WITH_READAHEAD
+#  error CONF_WITH_READAHEAD requires CONF_WITH_BDOS_CACHE.
+# endif
+#endif
+
+#if !CONF_WITH_FREE_BITMAP
+# if CONF_WITH_PREALLOC
+#  error CONF_WITH_PREALLOC requires CONF_WITH_FREE_BITMAP.
+# endif
+#endif
+
 #if !CONF_WITH_TTRAM
 # if CONF_TTRAM_SIZE != 0
 #  error CONF_TTRAM_SIZE != 0 requires CONF_WITH_TTRAM.
@@ -42,6 +42,7 @@ struct cookie {
 #define COOKIE__5MS     0x5f354d53L
 #define COOKIE_NVDI     0x4e564449L
 #define COOKIE_SCSIDRIV 0x53435349L
+#define COOKIE_BDST     0x42445354L     /* EmuTOS GEMDOS statistics */
 
 /*
  * values of _MCH cookie
@@ -67,6 +67,11 @@ static __inline__ WORD dos_snext(void)
     return Fsnext();
 }
 
+static __inline__ LONG dos_snextn(DTAENTRY *buf, WORD count)
+{
+    return Fsnextn(buf,count);
+}
+
 static __inline__ LONG dos_open(char *pname, WORD access)
 {
     return Fopen(pname,access);
@@ -87,6 +92,11 @@ static __inline__ LONG dos_write(WORD handle, LONG cnt, void *pbuffer)
     return Fwrite(handle,cnt,pbuffer);
 }
 
+static __inline__ LONG dos_copy(WORD srchandle, WORD dsthandle, LONG cnt)
+{
+    return Fcopy(srchandle,dsthandle,cnt);
+}
+
 static __inline__ LONG dos_lseek(WORD handle, WORD smode, LONG sofst)
 {
     return Fseek(sofst, handle, smode);
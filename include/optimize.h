@@ -10,6 +10,8 @@
 #ifndef OPTIMIZE_H
 #define OPTIMIZE_H
 
+#include "bdosdefs.h"
+
 char *filename_start(char *path);
 void fmt_str(const char *instr, char *outstr);
 void unfmt_str(const char *instr, char *outstr);
@@ -19,5 +21,7 @@ WORD inf_gindex(OBJECT *tree, WORD baseobj, WORD numobj);
 WORD inf_what(OBJECT *tree, WORD ok);
 char *scan_2(char *pcurr, WORD *pwd);
 WORD wildcmp(const char *pwld, const char *ptst);
+WORD dir_sfirst(char *pspec, WORD attr);
+WORD dir_snext(DTA *dta);
 
 #endif
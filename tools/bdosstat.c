@@ -0,0 +1,120 @@
+/*
+ * Display the GEMDOS statistics of an instrumented EmuTOS
+ *
+ * EmuTOS must have been built with CONF_WITH_BDOS_STATS.  The statistics
+ * are found via the BDST cookie and displayed on the screen.  Then they
+ * can be cleared, or also printed via kprintf() (e.g. to the emulator's
+ * console, via NatFeats).
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o BDOSSTAT.TOS -Wall bdosstat.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define COOKIE_BDST 0x42445354L
+
+/* must match BDOSSTATS in include/bdosdefs.h */
+#define NHIST   8
+
+typedef struct {
+    unsigned long calls;
+    unsigned long ticks;
+    unsigned long maxticks;
+    unsigned long hist[NHIST];
+} FNSTATS;
+
+typedef struct {
+    unsigned short version;
+    unsigned short nfuncs;
+    void (*dump)(void);
+    void (*reset)(void);
+    unsigned long start;
+    unsigned long cachehits;
+    unsigned long cachemisses;
+    unsigned long cacheflushes;
+    unsigned long readaheads;
+    unsigned long directrecs;
+    unsigned long devreads;
+    unsigned long devwrites;
+    unsigned long recsread;
+    unsigned long recswritten;
+    unsigned long dndhits;
+    unsigned long dndmisses;
+    unsigned long dndevictions;
+    FNSTATS fn[1];
+} STATS;
+
+static STATS *stats;
+
+static long find_stats(void) {
+    long *p = *(long **)0x5a0;
+
+    if (p) {
+        for ( ; *p; p += 2) {
+            if (*p == COOKIE_BDST) {
+                stats = (STATS *)p[1];
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+static long dump(void) {
+    stats->dump();
+    return 0;
+}
+
+static long reset(void) {
+    stats->reset();
+    return 0;
+}
+
+int main(void) {
+    FNSTATS *f;
+    long secs, c;
+    int fn, i;
+
+    Supexec(find_stats);
+    if (!stats || (stats->version != 2)) {
+        printf("No EmuTOS GEMDOS statistics available\r\n");
+        return 1;
+    }
+
+    secs = (bnch_ticks() - stats->start) / 200;
+    printf("GEMDOS statistics for the last %ld seconds\r\n", secs);
+    printf("Cache: %lu hits, %lu misses, %lu flushes\r\n",
+           stats->cachehits, stats->cachemisses, stats->cacheflushes);
+    printf("       %lu read ahead, %lu direct\r\n",
+           stats->readaheads, stats->directrecs);
+    printf("I/O:   %lu reads (%lu recs), %lu writes (%lu recs)\r\n",
+           stats->devreads, stats->recsread, stats->devwrites, stats->recswritten);
+    printf("DNDs:  %lu hits, %lu misses, %lu evictions\r\n",
+           stats->dndhits, stats->dndmisses, stats->dndevictions);
+    printf("Func    Calls    Ticks  Max  Calls by ticks 0,1,2-3..64+\r\n");
+    for (fn = 0, f = stats->fn; fn < stats->nfuncs; fn++, f++) {
+        if (!f->calls)
+            continue;
+        printf("0x%02x %8lu %8lu %4lu ", fn, f->calls, f->ticks, f->maxticks);
+        for (i = 0; i < NHIST; i++)
+            printf(" %lu", f->hist[i]);
+        printf("\r\n");
+    }
+
+    printf("K = kprintf() them, C = clear them, other key = exit\r\n");
+    c = Cnecin() & 0xff;
+    if ((c == 'k') || (c == 'K'))
+        Supexec(dump);
+    else if ((c == 'c') || (c == 'C'))
+        Supexec(reset);
+
+    return 0;
+}
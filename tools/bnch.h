@@ -0,0 +1,46 @@
+/*
+ * bnch.h - timing helpers shared by the benchmark tools
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#ifndef BNCH_H
+#define BNCH_H
+
+#include <stdio.h>
+#include <osbind.h>
+
+/* print a tick count as seconds, e.g. printf(BNCH_SECS_FMT, BNCH_SECS(t)) */
+#define BNCH_SECS_FMT   "%ld.%02ld seconds"
+#define BNCH_SECS(t)    (t)/200, ((t)%200)/2
+
+static __inline__ long bnch_hz200(void)
+{
+    return *(volatile long *)0x4ba;
+}
+
+/* current value of the 200 Hz system timer */
+static __inline__ long bnch_ticks(void)
+{
+    return Supexec(bnch_hz200);
+}
+
+/* speed in KB/s of a transfer of 'bytes' that took 'ticks' */
+static __inline__ long bnch_kbps(long bytes, long ticks)
+{
+    if (ticks <= 0)
+        ticks = 1;
+    return (bytes / 1024) * 200 / ticks;
+}
+
+/* keep the results on screen when started from the desktop */
+static __inline__ void bnch_wait(void)
+{
+    printf("Press any key\r\n");
+    Cconin();
+}
+
+#endif /* BNCH_H */
@@ -0,0 +1,66 @@
+/*
+ * Console output benchmark
+ *
+ * Times writing 1 MB of text lines to the console, first with Fwrite()
+ * to the standard output handle in 4 KB blocks (like the "type" command
+ * of EmuCON), then line by line with Cconws().
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o CONBNCH.TOS -Wall conbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define TOTALSIZE   (1024*1024L)
+#define BLOCKSIZE   4096
+#define LINELEN     64          /* including CR/LF */
+
+static char buf[BLOCKSIZE];
+
+static void fill(void) {
+    char *p;
+    int i, j;
+
+    for (i = 0, p = buf; i < BLOCKSIZE/LINELEN; i++) {
+        for (j = 0; j < LINELEN-2; j++)
+            *p++ = (j % 9 == 8) ? '\t' : ' ' + (i + j) % 95;
+        *p++ = '\r';
+        *p++ = '\n';
+    }
+}
+
+int main(void) {
+    static char line[LINELEN+1];
+    long n, fwrite_ticks, cconws_ticks, start;
+    int i;
+
+    fill();
+
+    start = bnch_ticks();
+    for (n = 0; n < TOTALSIZE; n += BLOCKSIZE)
+        Fwrite(1, BLOCKSIZE, buf);
+    fwrite_ticks = bnch_ticks() - start;
+
+    start = bnch_ticks();
+    for (n = 0; n < TOTALSIZE; n += BLOCKSIZE) {
+        for (i = 0; i < BLOCKSIZE; i += LINELEN) {
+            memcpy(line, buf+i, LINELEN);
+            Cconws(line);
+        }
+    }
+    cconws_ticks = bnch_ticks() - start;
+
+    printf("\033E1 MB via Fwrite(): " BNCH_SECS_FMT "\r\n", BNCH_SECS(fwrite_ticks));
+    printf("1 MB via Cconws(): " BNCH_SECS_FMT "\r\n", BNCH_SECS(cconws_ticks));
+    bnch_wait();
+
+    return 0;
+}
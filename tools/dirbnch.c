@@ -0,0 +1,123 @@
+/*
+ * Directory walk benchmark
+ *
+ * Times walking the directory tree given on the command line (default:
+ * the root of the current drive) with Fsfirst()/Fsnext(), several times.
+ * The first walk reads the directories from the drive, the following
+ * ones mostly find them in the GEMDOS cache, so they show the cost of
+ * validating the cached records.
+ *
+ * The cached walks are timed twice: first with a pass-through hook on
+ * hdv_mediach, which makes EmuTOS call Mediach() on every cache hit as
+ * it did before the media change window, then with the hook removed,
+ * so that the two results can be compared on the same machine.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o DIRBNCH.TTP -Wall dirbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define NUMWALKS    5
+#define MAXPATH     256
+
+static char path[MAXPATH];
+static long files, dirs;
+
+/* the hook only jumps to the previous hdv_mediach vector */
+long old_mediach __asm__("old_mediach");
+long mediach_hook(void) __asm__("mediach_hook");
+
+__asm__
+(
+    "mediach_hook:\n\t"
+    "move.l old_mediach,-(sp)\n\t"
+    "rts"
+);
+
+static long install_hook(void) {
+    old_mediach = *(long *)0x47e;
+    *(long *)0x47e = (long)mediach_hook;
+    return 0;
+}
+
+static long remove_hook(void) {
+    *(long *)0x47e = old_mediach;
+    return 0;
+}
+
+/* walk the directory in path[], which ends with a backslash */
+static void walk(void) {
+    _DTA dta, *olddta;
+    size_t len = strlen(path);
+    long ret;
+
+    olddta = Fgetdta();
+    Fsetdta(&dta);
+
+    strcpy(path+len, "*.*");
+    for (ret = Fsfirst(path, FA_DIR|FA_HIDDEN|FA_SYSTEM); ret == 0; ret = Fsnext()) {
+        if (!(dta.dta_attribute & FA_DIR)) {
+            files++;
+            continue;
+        }
+        if (dta.dta_name[0] == '.')
+            continue;
+        if (len + strlen(dta.dta_name) + 5 > MAXPATH)
+            continue;
+        dirs++;
+        strcpy(path+len, dta.dta_name);
+        strcat(path+len, "\\");
+        walk();
+    }
+    path[len] = '\0';
+
+    Fsetdta(olddta);
+}
+
+/* average time of the cached walks */
+static long walks(void) {
+    long start = bnch_ticks();
+    int i;
+
+    for (i = 1; i < NUMWALKS; i++)
+        walk();
+
+    return (bnch_ticks() - start) / (NUMWALKS - 1);
+}
+
+int main(int argc, char **argv) {
+    long first, hooked, ticks, start;
+
+    strcpy(path, (argc > 1) ? argv[1] : "\\");
+    if (path[strlen(path)-1] != '\\')
+        strcat(path, "\\");
+
+    start = bnch_ticks();
+    walk();
+    first = bnch_ticks() - start;
+
+    printf("%s: %ld files in %ld directories\r\n", path, files, dirs);
+    printf("First walk: " BNCH_SECS_FMT "\r\n", BNCH_SECS(first));
+
+    Supexec(install_hook);
+    hooked = walks();
+    Supexec(remove_hook);
+    printf("Then, with Mediach() on every cache hit: " BNCH_SECS_FMT "\r\n",
+           BNCH_SECS(hooked));
+
+    ticks = walks();
+    printf("Then, with the media change window: " BNCH_SECS_FMT "\r\n",
+           BNCH_SECS(ticks));
+    bnch_wait();
+
+    return 0;
+}
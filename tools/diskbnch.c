@@ -0,0 +1,107 @@
+/*
+ * Raw disk read benchmark
+ *
+ * Times reading 1 MB from the drive given on the command line (default:
+ * the current drive) with Rwabs(), using requests of various sizes, into
+ * a buffer in ST-RAM, then into a buffer in Alt-RAM if there is some.
+ * Each test reads its own area of the drive, so that it does not find the
+ * data in a cache left behind by the previous one.  Nothing is written.
+ * Under Hatari, use an emulated Falcon with an IDE disk image to measure
+ * the IDE driver.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o DISKBNCH.TTP -Wall diskbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <ctype.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define TOTALSIZE   (1024*1024L)
+#define MAXREQSIZE  (128*1024L)
+#define NUMSIZES    5
+
+static const long reqsizes[NUMSIZES] = { 512, 4096, 16384, 65536L, MAXREQSIZE };
+static long nextrec;            /* start of the area for the next test */
+
+/* read TOTALSIZE bytes starting at record 'first'; returns ticks or error */
+static long readtest(int dev, char *buf, long recsiz, long reqsize, long first) {
+    long start, recno, n, ret;
+
+    n = reqsize / recsiz;
+    start = bnch_ticks();
+    for (recno = first; recno < first + TOTALSIZE/recsiz; recno += n) {
+        ret = Rwabs(0, buf, (int)n, (int)recno, dev);
+        if (ret < 0)
+            return ret;
+    }
+
+    return bnch_ticks() - start;
+}
+
+static int runtests(int dev, char *buf, long recsiz, const char *what) {
+    long ticks;
+    int i, errors = 0;
+
+    printf("Buffer in %s:\r\n", what);
+    for (i = 0; i < NUMSIZES; i++) {
+        if (reqsizes[i] < recsiz)
+            continue;
+        ticks = readtest(dev, buf, recsiz, reqsizes[i], nextrec);
+        nextrec += TOTALSIZE / recsiz;
+        if (ticks < 0) {
+            printf("%6ld byte requests: error %ld\r\n", reqsizes[i], ticks);
+            errors++;
+            continue;
+        }
+        printf("%6ld byte requests: %ld KB in " BNCH_SECS_FMT ", %ld KB/s\r\n",
+               reqsizes[i], TOTALSIZE/1024, BNCH_SECS(ticks),
+               bnch_kbps(TOTALSIZE, ticks));
+    }
+
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    _BPB *bpb;
+    char *buf;
+    int dev, errors;
+
+    dev = (argc > 1) ? toupper((unsigned char)argv[1][0]) - 'A' : Dgetdrv();
+    bpb = Getbpb(dev);
+    if (!bpb) {
+        printf("Drive %c: not available\r\n", 'A'+dev);
+        return 1;
+    }
+    if (((long)bpb->numcl * bpb->clsizb) < 2 * NUMSIZES * TOTALSIZE) {
+        printf("Drive %c: too small\r\n", 'A'+dev);
+        return 1;
+    }
+    printf("Drive %c:, %u-byte records\r\n", 'A'+dev, bpb->recsiz);
+
+    buf = (char *)Mxalloc(MAXREQSIZE, 0);
+    if ((long)buf == -32L)      /* EINVFN: no Mxalloc(), so no Alt-RAM */
+        buf = (char *)Malloc(MAXREQSIZE);
+    if (!buf) {
+        printf("Not enough memory\r\n");
+        return 1;
+    }
+    errors = runtests(dev, buf, bpb->recsiz, "ST-RAM");
+    Mfree(buf);
+
+    buf = (char *)Mxalloc(MAXREQSIZE, 1);
+    if ((long)buf > 0) {
+        errors += runtests(dev, buf, bpb->recsiz, "Alt-RAM");
+        Mfree(buf);
+    }
+
+    bnch_wait();
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,94 @@
+/*
+ * Sequential write/read benchmark on a fragmented GEMDOS volume
+ *
+ * Fragments the free space of the current drive by creating many small
+ * files and deleting every other one.  Then writes two files at the
+ * same time, in small interleaved parts, and reads them back, timing
+ * both phases.  All files are deleted at the end.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o FRAGBNCH.TOS -Wall fragbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define NUMSMALL    200         /* small files used to fragment the disk */
+#define SMALLSIZE   2048L
+#define PARTSIZE    4096L       /* size of each write */
+#define NUMPARTS    128         /* parts written to each big file */
+
+static char buf[PARTSIZE];
+static char name[16];
+
+static char *smallname(int i) {
+    sprintf(name, "FRAG%04d.TMP", i);
+    return name;
+}
+
+static void report(const char *what, long ticks) {
+    long kb = 2 * NUMPARTS * PARTSIZE / 1024;
+
+    printf("%s %ld KB in " BNCH_SECS_FMT "\r\n",
+           what, kb, BNCH_SECS(ticks));
+}
+
+int main(void) {
+    long h, h1, h2, start;
+    int i;
+
+    printf("Fragmenting free space ...\r\n");
+    for (i = 0; i < NUMSMALL; i++) {
+        h = Fcreate(smallname(i), 0);
+        if (h < 0)
+            break;
+        Fwrite(h, SMALLSIZE, buf);
+        Fclose(h);
+    }
+    for (i = 0; i < NUMSMALL; i += 2)
+        Fdelete(smallname(i));
+
+    h1 = Fcreate("FRAGBNC1.DAT", 0);
+    h2 = Fcreate("FRAGBNC2.DAT", 0);
+    if ((h1 < 0) || (h2 < 0)) {
+        printf("Cannot create test files\r\n");
+        return 1;
+    }
+
+    start = bnch_ticks();
+    for (i = 0; i < NUMPARTS; i++) {
+        if ((Fwrite(h1, PARTSIZE, buf) != PARTSIZE) || (Fwrite(h2, PARTSIZE, buf) != PARTSIZE)) {
+            printf("Write error\r\n");
+            return 1;
+        }
+    }
+    Fclose(h1);
+    Fclose(h2);
+    report("Wrote", bnch_ticks() - start);
+
+    h1 = Fopen("FRAGBNC1.DAT", 0);
+    h2 = Fopen("FRAGBNC2.DAT", 0);
+    start = bnch_ticks();
+    for (i = 0; i < NUMPARTS; i++)
+        Fread(h1, PARTSIZE, buf);
+    for (i = 0; i < NUMPARTS; i++)
+        Fread(h2, PARTSIZE, buf);
+    report("Read", bnch_ticks() - start);
+    Fclose(h1);
+    Fclose(h2);
+
+    Fdelete("FRAGBNC1.DAT");
+    Fdelete("FRAGBNC2.DAT");
+    for (i = 1; i < NUMSMALL; i += 2)
+        Fdelete(smallname(i));
+
+    bnch_wait();
+
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Program load benchmark
+ *
+ * Times loading (and relocating) the programs given on the command line
+ * with Pexec() mode 3 (load, don't go), several times each, and frees
+ * them again without running them.  Run it with programs of various
+ * sizes, from various drives.  The EmuTOS program cache is emptied
+ * first, so the first load and the following ones are timed separately.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o LOADBNCH.TTP -Wall loadbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <osbind.h>
+#include <basepage.h>
+#include "bnch.h"
+
+#define NUMLOADS    5
+
+#define Pflush()    trap_1_w(0x1e)  /* EmuTOS extension */
+
+static long load(const char *name, long *size) {
+    BASEPAGE *bp;
+    long start;
+
+    start = bnch_ticks();
+    bp = (BASEPAGE *)Pexec(3, name, "\0", NULL);
+    if ((long)bp < 0)
+        return (long)bp;
+    start = bnch_ticks() - start;
+
+    *size = bp->p_tlen + bp->p_dlen;
+    Mfree(bp->p_env);
+    Mfree(bp);
+
+    return start;
+}
+
+static int loadtest(const char *name) {
+    long ticks, first, size;
+    int i;
+
+    Pflush();
+    first = load(name, &size);
+    if (first < 0) {
+        printf("%s: cannot load, error %ld\r\n", name, first);
+        return 1;
+    }
+    for (i = 1, ticks = 0; i < NUMLOADS; i++)
+        ticks += load(name, &size);
+    ticks /= NUMLOADS - 1;
+
+    printf("%s: %ld KB loaded in " BNCH_SECS_FMT ", then " BNCH_SECS_FMT "\r\n",
+           name, size/1024, BNCH_SECS(first), BNCH_SECS(ticks));
+
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int i, errors = 0;
+
+    if (argc < 2) {
+        printf("Usage: LOADBNCH program ...\r\n");
+        return 1;
+    }
+
+    for (i = 1; i < argc; i++)
+        errors += loadtest(argv[i]);
+
+    bnch_wait();
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Malloc()/Mfree() benchmark
+ *
+ * Times a pseudo-random mix of Malloc() and Mfree() calls of small and
+ * medium sizes, which keeps many blocks allocated at the same time and
+ * fragments the free memory, then times a series of Malloc(-1) calls.
+ * The allocated blocks are freed at the end.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o MALLBNCH.TOS -Wall mallbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define NUMSLOTS    300         /* blocks allocated at the same time, at most */
+#define NUMOPS      20000L      /* Malloc()/Mfree() calls */
+#define NUMMAXFREE  5000L       /* Malloc(-1) calls */
+
+static void *slot[NUMSLOTS];
+static unsigned long seed = 1;
+
+static unsigned long rnd(void) {
+    seed = seed * 1664525UL + 1013904223UL;
+    return seed >> 8;
+}
+
+static void report(const char *what, long n, long ticks) {
+    printf("%s %ld calls in " BNCH_SECS_FMT "\r\n",
+           what, n, BNCH_SECS(ticks));
+}
+
+int main(void) {
+    long op, size, start, fails = 0;
+    int i;
+
+    printf("Largest free block: %ld bytes\r\n", (long)Malloc(-1L));
+
+    start = bnch_ticks();
+    for (op = 0; op < NUMOPS; op++) {
+        i = rnd() % NUMSLOTS;
+        if (slot[i]) {
+            Mfree(slot[i]);
+            slot[i] = NULL;
+        } else {
+            size = (rnd() & 8) ? (rnd() & 0x3fff) + 16 : (rnd() & 0xff) + 16;
+            slot[i] = (void *)Malloc(size);
+            if (!slot[i])
+                fails++;
+        }
+    }
+    report("Malloc/Mfree:", NUMOPS, bnch_ticks() - start);
+
+    start = bnch_ticks();
+    for (op = 0; op < NUMMAXFREE; op++)
+        Malloc(-1L);
+    report("Malloc(-1):  ", NUMMAXFREE, bnch_ticks() - start);
+
+    for (i = 0; i < NUMSLOTS; i++)
+        if (slot[i])
+            Mfree(slot[i]);
+
+    printf("%ld failed allocations\r\n", fails);
+    printf("Largest free block: %ld bytes\r\n", (long)Malloc(-1L));
+    bnch_wait();
+
+    return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * Sequential read benchmark for GEMDOS file systems
+ *
+ * Times reading files on the current drive sequentially one byte at a
+ * time, 128 bytes at a time and 4 KB at a time.  Each test uses its own
+ * file, so that it does not find the data in the cache left behind by
+ * the previous one.  The data read is checked too.  The test files are
+ * deleted at the end.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o READBNCH.TOS -Wall readbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define FILESIZE    (128*1024L)
+#define BIGSIZE     4096L
+
+static unsigned char buf[BIGSIZE];
+
+static unsigned char pattern(long n) {
+    return (unsigned char)(n ^ (n >> 8));
+}
+
+static int makefile(const char *name) {
+    long h, pos, i;
+
+    h = Fcreate(name, 0);
+    if (h < 0)
+        return -1;
+    for (pos = 0; pos < FILESIZE; pos += BIGSIZE) {
+        for (i = 0; i < BIGSIZE; i++)
+            buf[i] = pattern(pos+i);
+        if (Fwrite(h, BIGSIZE, buf) != BIGSIZE) {
+            Fclose(h);
+            return -1;
+        }
+    }
+    Fclose(h);
+
+    return 0;
+}
+
+static int readtest(const char *name, long size) {
+    long h, n, pos, i, start, ticks;
+    int errors = 0;
+
+    h = Fopen(name, 0);
+    if (h < 0) {
+        printf("Cannot open test file\r\n");
+        return 1;
+    }
+
+    start = bnch_ticks();
+    for (pos = 0; pos < FILESIZE; pos += n) {
+        n = Fread(h, size, buf);
+        if (n <= 0)
+            break;
+        for (i = 0; i < n; i++)
+            if (buf[i] != pattern(pos+i))
+                errors++;
+    }
+    ticks = bnch_ticks() - start;
+    Fclose(h);
+    Fdelete(name);
+
+    if (pos != FILESIZE)
+        errors++;
+    printf("%4ld byte reads: %ld KB in " BNCH_SECS_FMT ", %d errors\r\n",
+           size, pos/1024, BNCH_SECS(ticks), errors);
+
+    return errors;
+}
+
+int main(void) {
+    static const char *names[] = { "READBNC1.DAT", "READBNC2.DAT", "READBNC3.DAT" };
+    static const long sizes[] = { 1, 128, BIGSIZE };
+    int i, errors = 0;
+
+    printf("Creating test files ...\r\n");
+    for (i = 0; i < 3; i++) {
+        if (makefile(names[i]) < 0) {
+            printf("Cannot create test file %s\r\n", names[i]);
+            while (i >= 0)
+                Fdelete(names[i--]);
+            return 1;
+        }
+    }
+
+    for (i = 0; i < 3; i++)
+        errors += readtest(names[i], sizes[i]);
+
+    bnch_wait();
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,193 @@
+/*
+ * SD/MMC block transfer benchmark
+ *
+ * Times reading 1 MB from each SD/MMC card found, with physical Rwabs()
+ * calls of various sizes, and reports the speed in KB/s.  Each test
+ * reads its own area of the card, so that it does not find the data in
+ * a cache left behind by the previous one.  The card is identified via
+ * XHDI: block-addressed cards (more than 2 GB) are SDHC/SDXC, the others
+ * are SDSC or MMC.  With -w, each area is then written back unchanged,
+ * with the same request sizes; this needs 1 MB of free memory.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o SDBNCH.TTP -Wall sdbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define COOKIE_XHDI 0x58484449L
+
+#define SD_MAJOR    24          /* first XHDI major number of SD/MMC */
+#define SD_UNITS    8
+#define SD_UNIT0    26          /* physical Rwabs() unit of SD_MAJOR */
+#define RW_PHYS     8           /* Rwabs() physical mode */
+
+#define SECSIZE     512
+#define TOTALSIZE   (1024*1024L)
+#define MAXSECS     128
+#define NUMSIZES    4
+#define MAXBYTECARD (4L*1024*1024)  /* sectors in 2 GB */
+
+static const int reqsecs[NUMSIZES] = { 1, 8, 64, MAXSECS };
+
+static long (*xhdi)(void);
+static unsigned short xhmajor;
+static unsigned long xhblocks, xhblocksize, xhflags;
+static char xhname[33];
+
+static long find_xhdi(void) {
+    long *p = *(long **)0x5a0;
+
+    if (p) {
+        for ( ; *p; p += 2) {
+            if (*p == COOKIE_XHDI) {
+                xhdi = (long (*)(void))p[1];
+                break;
+            }
+        }
+    }
+    return 0;
+}
+
+/* the XHDI functions take word arguments, so push them by hand */
+static long xhgetcapacity(void) {
+    register long ret __asm__("d0");
+
+    __asm__ volatile
+    (
+        "move.l %3,-(sp)\n\t"
+        "move.l %2,-(sp)\n\t"
+        "clr.w  -(sp)\n\t"
+        "move.w %1,-(sp)\n\t"
+        "move.w #14,-(sp)\n\t"      /* XHGETCAPACITY */
+        "jsr    (%4)\n\t"
+        "lea    14(sp),sp"
+    : "=r"(ret)
+    : "d"(xhmajor), "g"(&xhblocks), "g"(&xhblocksize), "a"(xhdi)
+    : "d1", "d2", "a0", "a1", "a2", "cc", "memory"
+    );
+
+    return ret;
+}
+
+static long xhinqtarget2(void) {
+    register long ret __asm__("d0");
+
+    __asm__ volatile
+    (
+        "move.w #33,-(sp)\n\t"
+        "move.l %4,-(sp)\n\t"
+        "move.l %3,-(sp)\n\t"
+        "move.l %2,-(sp)\n\t"
+        "clr.w  -(sp)\n\t"
+        "move.w %1,-(sp)\n\t"
+        "move.w #11,-(sp)\n\t"      /* XHINQTARGET2 */
+        "jsr    (%5)\n\t"
+        "lea    20(sp),sp"
+    : "=r"(ret)
+    : "d"(xhmajor), "g"(&xhblocksize), "g"(&xhflags), "g"(xhname), "a"(xhdi)
+    : "d1", "d2", "a0", "a1", "a2", "cc", "memory"
+    );
+
+    return ret;
+}
+
+/* transfer TOTALSIZE bytes starting at sector 'first'; returns ticks or error */
+static long rwtest(int rw, int unit, char *buf, int n, long first) {
+    long start, sector, ret;
+    char *p;
+
+    if (rw) {
+        /* read the area first, so that it can be written back unchanged */
+        for (sector = first, p = buf; sector < first + TOTALSIZE/SECSIZE;
+                                sector += MAXSECS, p += MAXSECS*SECSIZE) {
+            ret = Rwabs(RW_PHYS, p, MAXSECS, -1, unit, sector);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    start = bnch_ticks();
+    for (sector = first, p = buf; sector < first + TOTALSIZE/SECSIZE; sector += n) {
+        ret = Rwabs(RW_PHYS|rw, p, n, -1, unit, sector);
+        if (ret < 0)
+            return ret;
+        if (rw)
+            p += n * SECSIZE;
+    }
+
+    return bnch_ticks() - start;
+}
+
+static int runtests(int rw, int unit, char *buf, const char *type) {
+    long ticks, first;
+    int i, errors = 0;
+
+    for (i = 0, first = 0; i < NUMSIZES; i++, first += TOTALSIZE/SECSIZE) {
+        ticks = rwtest(rw, unit, buf, reqsecs[i], first);
+        if (ticks < 0) {
+            printf("  %s, %3d sector %s: error %ld\r\n",
+                   type, reqsecs[i], rw ? "writes" : "reads", ticks);
+            errors++;
+            continue;
+        }
+        printf("  %s, %3d sector %s: %ld KB/s\r\n", type, reqsecs[i],
+               rw ? "writes" : "reads", bnch_kbps(TOTALSIZE, ticks));
+    }
+
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    const char *type;
+    char *buf;
+    int i, dowrite = 0, found = 0, errors = 0;
+
+    if ((argc > 1) && (strcmp(argv[1], "-w") == 0))
+        dowrite = 1;
+
+    Supexec(find_xhdi);
+    if (!xhdi) {
+        printf("No XHDI driver\r\n");
+        return 1;
+    }
+
+    buf = (char *)Malloc(dowrite ? TOTALSIZE : MAXSECS * SECSIZE);
+    if (!buf) {
+        printf("Not enough memory\r\n");
+        return 1;
+    }
+
+    for (i = 0; i < SD_UNITS; i++) {
+        xhmajor = SD_MAJOR + i;
+        xhname[0] = '\0';
+        if (Supexec(xhgetcapacity) != 0)
+            continue;
+        Supexec(xhinqtarget2);
+        if ((xhblocksize != SECSIZE) || (xhblocks < NUMSIZES * TOTALSIZE/SECSIZE))
+            continue;
+        found++;
+        type = (xhblocks > MAXBYTECARD) ? "SDHC/SDXC" : "SDSC/MMC";
+        printf("SD/MMC device %d: %s, %lu MB, %s\r\n",
+               i, xhname, xhblocks / (1024*1024L/SECSIZE), type);
+        errors += runtests(0, SD_UNIT0 + i, buf, type);
+        if (dowrite)
+            errors += runtests(1, SD_UNIT0 + i, buf, type);
+    }
+    Mfree(buf);
+
+    if (!found)
+        printf("No SD/MMC card found\r\n");
+
+    bnch_wait();
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Random seek benchmark for GEMDOS file systems
+ *
+ * Creates a fragmented file on the current drive by writing two files
+ * alternately, deletes one of them, then times random Fseek()/Fread()
+ * on the other one.  Each block of the file contains its own offset,
+ * so the data read is checked too.
+ *
+ * Compile with:
+ *      m68k-atari-mint-gcc -o SEEKBNCH.TOS -Wall seekbnch.c
+ *
+ * Copyright (C) 2024 The EmuTOS development team
+ *
+ * This file is distributed under the GPL, version 2 or at your
+ * option any later version.  See doc/license.txt for details.
+ */
+
+#include <stdio.h>
+#include <osbind.h>
+#include "bnch.h"
+
+#define BLKSIZE     512L
+#define CHUNKBLKS   4           /* blocks written to one file at a time */
+#define NUMCHUNKS   128
+#define NUMSEEKS    2000
+
+#define FILE1   "SEEKBNC1.DAT"
+#define FILE2   "SEEKBNC2.DAT"
+
+static long buf[BLKSIZE/sizeof(long)];
+
+/* Quick & dirty (mostly) portable random generator, see memstres.c */
+static unsigned long qdrand(void) {
+    static unsigned long idum = 0;
+    idum = 1664525L*idum + 1013904223L;
+    return idum;
+}
+
+static int writechunk(int h, long blk) {
+    int i;
+
+    for (i = 0; i < CHUNKBLKS; i++, blk++) {
+        buf[0] = blk * BLKSIZE;
+        if (Fwrite(h, BLKSIZE, buf) != BLKSIZE)
+            return -1;
+    }
+    return 0;
+}
+
+int main(void) {
+    long h1, h2, pos, start, ticks;
+    int i, errors = 0;
+
+    h1 = Fcreate(FILE1, 0);
+    h2 = Fcreate(FILE2, 0);
+    if ((h1 < 0) || (h2 < 0)) {
+        printf("Cannot create test files\r\n");
+        return 1;
+    }
+
+    printf("Writing %ld KB fragmented file ...\r\n",
+           NUMCHUNKS*CHUNKBLKS*BLKSIZE/1024);
+    for (i = 0; i < NUMCHUNKS; i++) {
+        if (writechunk(h1, (long)i*CHUNKBLKS) || writechunk(h2, (long)i*CHUNKBLKS)) {
+            printf("Write error\r\n");
+            return 1;
+        }
+    }
+    Fclose(h2);
+    Fdelete(FILE2);
+
+    printf("Doing %d random seeks ...\r\n", NUMSEEKS);
+    start = bnch_ticks();
+    for (i = 0; i < NUMSEEKS; i++) {
+        pos = (qdrand() >> 8) % (NUMCHUNKS*CHUNKBLKS) * BLKSIZE;
+        if ((Fseek(pos, h1, 0) != pos) || (Fread(h1, BLKSIZE, buf) != BLKSIZE)
+         || (buf[0] != pos))
+            errors++;
+    }
+    ticks = bnch_ticks() - start;
+
+    Fclose(h1);
+    Fdelete(FILE1);
+
+    printf("%d seeks in " BNCH_SECS_FMT ", %d errors\r\n",
+           NUMSEEKS, BNCH_SECS(ticks), errors);
+    bnch_wait();
+
+    return errors ? 1 : 0;
+}
@@ -1,6 +1,10 @@
 /*
  * boot.c - standalone PRG to load EmuTOS in RAM
  *
+ * The command line may give the size of the RAM disk in KB, which is
+ * passed to EmuTOS as the boot parameter ramdisk_size, e.g. "512" (see
+ * bios/ramdisk.c).
+ *
  * Copyright (C) 2001-2019 The EmuTOS development team
  *
  * Authors:
@@ -30,6 +34,10 @@ void bootram(const UBYTE *src, ULONG size, ULONG cpu) NORETURN;
 extern const UBYTE ramtos[];
 extern const UBYTE end_ramtos[];
 
+/* our basepage, saved by util/minicrt.S */
+extern const UBYTE *basepage;
+#define CMDTAIL     0x80        /* offset of the command tail */
+
 /*
  * cookie stuff
  */
@@ -83,6 +91,24 @@ static ULONG get_cookie(ULONG id)
   return 0L;
 }
 
+#if CONF_WITH_RAMDISK
+/* set the RAM disk size boot parameter from the command tail, if any */
+static void set_ramdisk_size(void)
+{
+  const UBYTE *p = basepage + CMDTAIL;
+  UWORD len = *p++;
+  ULONG kb = 0;
+
+  for ( ; len && (*p == ' '); len--)
+    p++;
+  for ( ; len && (*p >= '0') && (*p <= '9'); len--)
+    kb = kb * 10 + (*p++ - '0');
+
+  if (kb)
+    *CONST_CAST(ULONG *, ramtos + OFFSETOF(ADR_RAMDISK_SIZE)) = kb * 1024;
+}
+#endif
+
 int main(void)
 {
   ULONG count;
@@ -95,6 +121,10 @@ int main(void)
 
   count = end_ramtos - ramtos;
 
+#if CONF_WITH_RAMDISK
+  set_ramdisk_size();
+#endif
+
 #if DBG_BOOT
   /* get final address */
 
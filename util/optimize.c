@@ -21,6 +21,8 @@
 #include "intmath.h"
 #include "obdefs.h"
 #include "optimize.h"
+#include "gemdos.h"
+#include "gemerror.h"
 
 #include "string.h"
 #include "xbiosbind.h"
@@ -275,3 +277,58 @@ WORD i;
 
     return (*pattern == *filename);
 }
+
+
+#if CONF_WITH_FSNEXTN
+#define DIRBATCH    16          /* directory entries per Fsnextn() */
+
+static DTAENTRY dirbuf[DIRBATCH];
+static WORD dirnext, dircount;
+static BOOL dirnobatch;
+#endif
+
+/*
+ *  Directory search routines for the AES & EmuDesk.  These work like
+ *  dos_sfirst() & dos_snext() respectively, except that dir_snext()
+ *  is passed the current DTA.  When possible, dir_snext() gets the
+ *  entries from GEMDOS in batches via Fsnextn(), and returns them one
+ *  at a time from the batch.
+ */
+WORD dir_sfirst(char *pspec, WORD attr)
+{
+#if CONF_WITH_FSNEXTN
+    dirnext = dircount = 0;
+    dirnobatch = FALSE;
+#endif
+
+    return dos_sfirst(pspec, attr);
+}
+
+WORD dir_snext(DTA *dta)
+{
+#if CONF_WITH_FSNEXTN
+    LONG ret;
+
+    if ((dirnext >= dircount) && !dirnobatch)
+    {
+        ret = dos_snextn(dirbuf, DIRBATCH);
+        if (ret == EINVFN)      /* not available, e.g. GEMDOS is hooked */
+            dirnobatch = TRUE;
+        else if (ret < 0L)
+            return ret;
+        else
+        {
+            dirnext = 0;
+            dircount = ret;
+        }
+    }
+
+    if (dirnext < dircount)
+    {
+        memcpy(&dta->d_attrib, &dirbuf[dirnext++].d_attrib, sizeof(DTAENTRY)-1);
+        return 0;
+    }
+#endif
+
+    return dos_snext();
+}